@@ -1,64 +1,157 @@
 // src/a1i.cpp
 #include <iostream>
 #include <iomanip>
-#include <random>
-#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
-int main() {
-    std::ios::sync_with_stdio(false);
-    std::cin.tie(nullptr);
-
-    double xc[3], yc[3], r[3], r2[3];
-    for (int i = 0; i < 3; ++i) {
-        std::cin >> xc[i] >> yc[i] >> r[i];
-        r2[i] = r[i] * r[i];
-    }
+#include "area_estimator.h"
 
-    double lx = -1e18, rx = 1e18;
-    double ly = -1e18, ry = 1e18;
+static const int BATCH_RECORDS = 8192;
 
-    for (int i = 0; i < 3; ++i) {
-        lx = std::max(lx, xc[i] - r[i]);
-        rx = std::min(rx, xc[i] + r[i]);
-        ly = std::max(ly, yc[i] - r[i]);
-        ry = std::min(ry, yc[i] + r[i]);
+CircleSoA parse_circles(std::istream &in) {
+    CircleSoA circles;
+    double x, y, r;
+    while (in >> x >> y >> r) {
+        circles.add(x, y, r);
     }
+    return circles;
+}
 
-    if (lx >= rx || ly >= ry) {
-        std::cout << std::fixed << std::setprecision(10) << 0.0;
-        return 0;
+void format_result(std::string &out, double estimate, const EstimateOptions &opt,
+                   const EstimateReport &report) {
+    char buf[128];
+    int len;
+    if (opt.method == Method::MonteCarlo && opt.adaptive()) {
+        len = std::snprintf(buf, sizeof(buf), "%.10f %lld %.10f %.10f\n",
+                            estimate, report.samples, report.lo, report.hi);
+    } else {
+        len = std::snprintf(buf, sizeof(buf), "%.10f\n", estimate);
     }
+    out.append(buf, len);
+}
 
-    double w = rx - lx;
-    double h = ry - ly;
-    double areaRect = w * h;
+// One query per non-empty line. Records are read in chunks, estimated by a
+// pool of workers (one thread per query), and written back in input order
+// with a single write per chunk.
+void run_batch(std::istream &in, const EstimateOptions &opt, int workers) {
+    EstimateOptions queryOpt = opt;
+    queryOpt.threads = 1;
 
-    const int SAMPLES = 3000000;
+    std::vector<std::string> records;
+    std::vector<double> estimates;
+    std::vector<EstimateReport> reports;
+    std::string line;
+    std::string out;
+    bool more = true;
+    while (more) {
+        records.clear();
+        while (static_cast<int>(records.size()) < BATCH_RECORDS) {
+            if (!std::getline(in, line)) {
+                more = false;
+                break;
+            }
+            if (line.find_first_not_of(" \t\r") != std::string::npos) records.push_back(line);
+        }
+        int count = static_cast<int>(records.size());
+        if (count == 0) break;
 
-    std::mt19937_64 rng(123456789);
-    std::uniform_real_distribution<double> dist(0.0, 1.0);
+        estimates.assign(count, 0.0);
+        reports.assign(count, EstimateReport());
+        std::atomic<int> nextRecord(0);
+        auto worker = [&]() {
+            for (int i = nextRecord++; i < count; i = nextRecord++) {
+                std::istringstream rec(records[i]);
+                estimates[i] = estimate_area(parse_circles(rec), queryOpt, reports[i]);
+            }
+        };
+        int threads = std::max(1, std::min(workers, count));
+        std::vector<std::thread> pool;
+        for (int t = 1; t < threads; ++t) pool.emplace_back(worker);
+        worker();
+        for (auto &th : pool) th.join();
 
-    int inside = 0;
+        out.clear();
+        for (int i = 0; i < count; ++i) format_result(out, estimates[i], opt, reports[i]);
+        std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+    }
+    std::cout.flush();
+}
 
-    for (int i = 0; i < SAMPLES; ++i) {
-        double x = lx + w * dist(rng);
-        double y = ly + h * dist(rng);
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    std::cin.tie(nullptr);
 
-        bool ok = true;
-        for (int j = 0; j < 3; ++j) {
-            double dx = x - xc[j];
-            double dy = y - yc[j];
-            if (dx * dx + dy * dy > r2[j]) {
-                ok = false;
-                break;
+    EstimateOptions opt;
+    opt.threads = static_cast<int>(std::thread::hardware_concurrency());
+    bool batch = false;
+    const char *inputPath = nullptr;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--threads") == 0) opt.threads = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--samples") == 0) opt.samples = std::atoll(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--seed") == 0) opt.seed = std::strtoull(argv[i + 1], nullptr, 10);
+        else if (std::strcmp(argv[i], "--grid") == 0) opt.gridCells = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--target-abs") == 0) opt.targetAbs = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--target-rel") == 0) opt.targetRel = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--confidence") == 0) opt.confidence = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--scramble") == 0) opt.scramble = std::atoi(argv[i + 1]) != 0;
+        else if (std::strcmp(argv[i], "--batch") == 0) batch = std::atoi(argv[i + 1]) != 0;
+        else if (std::strcmp(argv[i], "--input") == 0) {
+            inputPath = argv[i + 1];
+            batch = true;
+        }
+        else if (std::strcmp(argv[i], "--method") == 0 && !parse_method(argv[i + 1], opt.method)) {
+            std::cerr << "Unknown method: " << argv[i + 1] << "\n";
+            return 1;
+        }
+        else if (std::strcmp(argv[i], "--sampler") == 0 && !parse_sampler(argv[i + 1], opt.sampler)) {
+            std::cerr << "Unknown sampler: " << argv[i + 1] << "\n";
+            return 1;
+        }
+        else if (std::strcmp(argv[i], "--kernel") == 0 && !parse_kernel(argv[i + 1], opt.kernel)) {
+            std::cerr << "Unsupported kernel: " << argv[i + 1] << "\n";
+            return 1;
+        }
+    }
+    if (opt.threads < 1) opt.threads = 1;
+    if (const char *err = check_options(opt)) {
+        std::cerr << err << "\n";
+        return 1;
+    }
+
+    if (batch) {
+        if (inputPath) {
+            std::ifstream file(inputPath);
+            if (!file) {
+                std::cerr << "Cannot open " << inputPath << " for reading\n";
+                return 1;
             }
+            run_batch(file, opt, opt.threads);
+        } else {
+            run_batch(std::cin, opt, opt.threads);
         }
-        if (ok) ++inside;
+        return 0;
     }
 
-    double estimate = areaRect * static_cast<double>(inside)
-                      / static_cast<double>(SAMPLES);
+    EstimateReport report;
+    double estimate = estimate_area(parse_circles(std::cin), opt, report);
 
+    if (opt.method == Method::Quadtree) {
+        std::cerr << std::fixed << std::setprecision(10)
+                  << "boundary_cells=" << report.boundaryCells
+                  << " covered_area=" << report.coveredArea
+                  << " std_error=" << report.stdError << "\n";
+    } else if (opt.method == Method::MonteCarlo && opt.adaptive()) {
+        std::cerr << std::fixed << std::setprecision(10)
+                  << "samples=" << report.samples << " interval=[" << report.lo << ", "
+                  << report.hi << "]" << " confidence=" << opt.confidence << "\n";
+    }
     std::cout << std::fixed << std::setprecision(10) << estimate;
     return 0;
 }
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#include "inside_kernel.h"
+#include "circle_grid.h"
+#include "xoshiro.h"
+#include "samplers.h"
+#include "quadtree.h"
+#include "exact_area.h"
+
+static const long long BLOCK_SAMPLES = 1 << 16;
+static const int KERNEL_BATCH = 512;
+
+static const int WARMUP_SAMPLES = 4096;
+static const int GRID_MIN_CIRCLES = 16;
+static const long long MAX_ROUND_BLOCKS = 64;
+
+// Every block of samples owns its own generator keyed by (seed, block index),
+// so the total does not depend on how blocks are spread over threads.
+template <class Test>
+long long count_inside_block(const Test &test, const UnitSampler &sampler, KernelKind kernel,
+                             double lx, double ly, double w, double h,
+                             std::uint64_t seed, long long block, long long count) {
+    BulkUniform rng(seed, static_cast<std::uint64_t>(block), kernel);
+
+    double px[KERNEL_BATCH], py[KERNEL_BATCH];
+    long long inside = 0;
+    for (long long done = 0; done < count; done += KERNEL_BATCH) {
+        int n = static_cast<int>(std::min<long long>(KERNEL_BATCH, count - done));
+        sampler.fill(block * BLOCK_SAMPLES + done, n, px, py, rng);
+        for (int i = 0; i < n; ++i) {
+            px[i] = lx + w * px[i];
+            py[i] = ly + h * py[i];
+        }
+        inside += test(px, py, n);
+    }
+    return inside;
+}
+
+template <class Test>
+long long count_inside_blocks(const Test &test, const UnitSampler &sampler, KernelKind kernel,
+                              double lx, double ly, double w, double h, long long samples,
+                              long long firstBlock, long long lastBlock,
+                              std::uint64_t seed, int threads) {
+    long long blocks = lastBlock - firstBlock;
+    if (threads < 1) threads = 1;
+    if (threads > blocks) threads = static_cast<int>(std::max(1LL, blocks));
+
+    std::vector<long long> partial(threads, 0);
+    auto worker = [&](int t) {
+        long long sum = 0;
+        for (long long b = firstBlock + t; b < lastBlock; b += threads) {
+            long long count = std::min(BLOCK_SAMPLES, samples - b * BLOCK_SAMPLES);
+            sum += count_inside_block(test, sampler, kernel, lx, ly, w, h, seed, b, count);
+        }
+        partial[t] = sum;
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker, t);
+    worker(0);
+    for (auto &th : pool) th.join();
+
+    long long inside = 0;
+    for (int t = 0; t < threads; ++t) inside += partial[t];
+    return inside;
+}
+
+template <class Test>
+long long count_inside_parallel(const Test &test, const UnitSampler &sampler, KernelKind kernel,
+                                double lx, double ly, double w, double h,
+                                long long samples, std::uint64_t seed, int threads) {
+    long long blocks = (samples + BLOCK_SAMPLES - 1) / BLOCK_SAMPLES;
+    return count_inside_blocks(test, sampler, kernel, lx, ly, w, h, samples,
+                               0, blocks, seed, threads);
+}
+
+inline double normal_quantile_two_sided(double confidence) {
+    double lo = 0.0, hi = 40.0;
+    for (int it = 0; it < 100; ++it) {
+        double mid = 0.5 * (lo + hi);
+        if (std::erf(mid / std::sqrt(2.0)) < confidence) lo = mid;
+        else hi = mid;
+    }
+    return 0.5 * (lo + hi);
+}
+
+// Wilson score interval for the inside fraction, scaled to an area; unlike the
+// plain normal interval it stays non-degenerate when no point (or every
+// point) has landed inside yet.
+inline void wilson_interval(long long inside, long long n, double z, double areaRect,
+                     double &lo, double &hi) {
+    double p = static_cast<double>(inside) / static_cast<double>(n);
+    double z2n = z * z / static_cast<double>(n);
+    double center = (p + 0.5 * z2n) / (1.0 + z2n);
+    double half = z / (1.0 + z2n)
+                  * std::sqrt(p * (1.0 - p) / static_cast<double>(n) + 0.25 * z2n / static_cast<double>(n));
+    lo = areaRect * std::max(0.0, center - half);
+    hi = areaRect * std::min(1.0, center + half);
+}
+
+// Rounds grow 1, 1, 2, 4, ... blocks up to MAX_ROUND_BLOCKS, so where the
+// estimator stops depends only on the seed, never on the thread count. The
+// Wilson interval assumes independent points, so the sampler must be random.
+template <class Test>
+long long count_inside_adaptive(const Test &test, const UnitSampler &sampler, KernelKind kernel,
+                                double lx, double ly, double w, double h,
+                                long long maxSamples, double targetAbs, double targetRel,
+                                double z, std::uint64_t seed, int threads,
+                                long long &used, double &lo, double &hi) {
+    long long maxBlocks = (maxSamples + BLOCK_SAMPLES - 1) / BLOCK_SAMPLES;
+    long long inside = 0;
+    long long done = 0;
+    long long round = 1;
+    used = 0;
+    while (done < maxBlocks) {
+        long long next = std::min(maxBlocks, done + round);
+        inside += count_inside_blocks(test, sampler, kernel, lx, ly, w, h, maxSamples,
+                                      done, next, seed, threads);
+        used = std::min(maxSamples, next * BLOCK_SAMPLES);
+        done = next;
+        if (done > 1) round = std::min(MAX_ROUND_BLOCKS, round * 2);
+
+        wilson_interval(inside, used, z, w * h, lo, hi);
+        double half = 0.5 * (hi - lo);
+        double estimate = w * h * static_cast<double>(inside) / static_cast<double>(used);
+        if ((targetAbs > 0 && half <= targetAbs) || (targetRel > 0 && half <= targetRel * estimate)) {
+            break;
+        }
+    }
+    return inside;
+}
+
+// Circles that reject most warm-up points go first, so the early exits in the
+// kernels and in the grid lists fire as soon as possible.
+inline std::vector<int> order_by_rejection(const CircleSoA &c, double lx, double ly,
+                                    double w, double h, std::uint64_t seed) {
+    BulkUniform rng(seed, ~0ull);
+    std::vector<double> px(WARMUP_SAMPLES), py(WARMUP_SAMPLES);
+    rng.fill(px.data(), WARMUP_SAMPLES);
+    rng.fill(py.data(), WARMUP_SAMPLES);
+
+    std::vector<int> rejected(c.size(), 0);
+    for (int i = 0; i < WARMUP_SAMPLES; ++i) {
+        double x = lx + w * px[i];
+        double y = ly + h * py[i];
+        for (int j = 0; j < c.size(); ++j) {
+            double dx = x - c.x[j];
+            double dy = y - c.y[j];
+            rejected[j] += dx * dx + dy * dy > c.r2[j];
+        }
+    }
+
+    std::vector<int> order(c.size());
+    for (int j = 0; j < c.size(); ++j) order[j] = j;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](int a, int b) { return rejected[a] > rejected[b]; });
+    return order;
+}
+
+enum class Method { Exact, MonteCarlo, Quadtree };
+
+inline bool parse_method(const char *s, Method &m) {
+    if (std::strcmp(s, "exact") == 0) m = Method::Exact;
+    else if (std::strcmp(s, "mc") == 0) m = Method::MonteCarlo;
+    else if (std::strcmp(s, "quadtree") == 0) m = Method::Quadtree;
+    else return false;
+    return true;
+}
+
+struct EstimateOptions {
+    Method method = Method::Exact;
+    long long samples = 3000000;
+    std::uint64_t seed = 123456789;
+    int threads = 1;
+    int gridCells = -1;
+    bool scramble = true;
+    double targetAbs = 0.0;
+    double targetRel = 0.0;
+    double confidence = 0.95;
+    KernelKind kernel = detect_kernel();
+    SamplerKind sampler = SamplerKind::Random;
+
+    bool adaptive() const { return targetAbs > 0 || targetRel > 0; }
+};
+
+struct EstimateReport {
+    long long samples = 0;
+    double lo = 0.0;
+    double hi = 0.0;
+    double stdError = 0.0;
+    int boundaryCells = 0;
+    double coveredArea = 0.0;
+};
+
+// Returns a message describing why the options cannot be used together, or
+// nullptr when they are fine.
+inline const char *check_options(const EstimateOptions &opt) {
+    // Options left at their defaults cannot be told apart from options never
+    // given, so an explicit default value still passes.
+    const EstimateOptions defaults;
+    bool sampling = opt.samples != defaults.samples || opt.sampler != defaults.sampler;
+    bool mcOnly = opt.adaptive() || opt.gridCells != defaults.gridCells ||
+                  opt.confidence != defaults.confidence;
+    if (opt.method == Method::Exact && (sampling || mcOnly)) {
+        return "--samples, --sampler, --grid, --confidence and --target-abs/--target-rel "
+               "only apply to --method mc (--samples also to --method quadtree)";
+    }
+    if (opt.method == Method::Quadtree && (opt.gridCells != defaults.gridCells ||
+                                           opt.confidence != defaults.confidence)) {
+        return "--grid and --confidence only apply to --method mc";
+    }
+    if (opt.adaptive() && (opt.confidence <= 0.0 || opt.confidence >= 1.0)) {
+        return "Confidence must be in (0, 1)";
+    }
+    if (opt.adaptive() && opt.sampler != SamplerKind::Random) {
+        return "--target-abs/--target-rel build a Wilson interval that assumes independent "
+               "points; only the random sampler can be combined with them";
+    }
+    if (opt.method == Method::Quadtree && (opt.adaptive() || opt.sampler != SamplerKind::Random)) {
+        return "--method quadtree uses its own per-cell random sampling and cannot be "
+               "combined with --sampler or --target-abs/--target-rel";
+    }
+    return nullptr;
+}
+
+inline double estimate_area(const CircleSoA &input, const EstimateOptions &opt,
+                            EstimateReport &report) {
+    report = EstimateReport();
+    if (opt.method == Method::Exact) return intersection_area(input);
+
+    double lx = -1e18, rx = 1e18;
+    double ly = -1e18, ry = 1e18;
+
+    for (int i = 0; i < input.size(); ++i) {
+        lx = std::max(lx, input.x[i] - input.r[i]);
+        rx = std::min(rx, input.x[i] + input.r[i]);
+        ly = std::max(ly, input.y[i] - input.r[i]);
+        ry = std::min(ry, input.y[i] + input.r[i]);
+    }
+
+    if (input.size() == 0 || lx >= rx || ly >= ry || opt.samples <= 0) return 0.0;
+
+    double w = rx - lx;
+    double h = ry - ly;
+    double areaRect = w * h;
+
+    CircleSoA circles = input.permuted(order_by_rejection(input, lx, ly, w, h, opt.seed));
+
+    if (opt.method == Method::Quadtree) {
+        QuadtreeEstimator tree(circles, lx, ly, w, h, opt.samples);
+        double estimate = tree.estimate(opt.samples, opt.seed, opt.threads, opt.kernel,
+                                        report.stdError);
+        report.samples = opt.samples;
+        report.boundaryCells = tree.boundary_cells();
+        report.coveredArea = tree.covered_area();
+        return estimate;
+    }
+
+    int gridCells = opt.gridCells;
+    if (gridCells < 0) {
+        gridCells = circles.size() >= GRID_MIN_CIRCLES
+                    ? CircleGrid::default_cells(circles.size()) : 0;
+    }
+
+    UnitSampler sampler(opt.sampler, opt.samples, opt.seed, opt.scramble);
+    long long inside = 0;
+    report.samples = opt.samples;
+    auto run = [&](const auto &test) {
+        if (opt.adaptive()) {
+            double z = normal_quantile_two_sided(opt.confidence);
+            inside = count_inside_adaptive(test, sampler, opt.kernel, lx, ly, w, h, opt.samples,
+                                           opt.targetAbs, opt.targetRel, z, opt.seed, opt.threads,
+                                           report.samples, report.lo, report.hi);
+        } else {
+            inside = count_inside_parallel(test, sampler, opt.kernel, lx, ly, w, h,
+                                           opt.samples, opt.seed, opt.threads);
+        }
+    };
+    if (gridCells > 0) {
+        CircleGrid grid(circles, lx, ly, w, h, gridCells);
+        run([&](const double *px, const double *py, int n) {
+            return grid.count_inside(px, py, n);
+        });
+    } else {
+        run([&](const double *px, const double *py, int n) {
+            return count_inside(opt.kernel, circles, px, py, n);
+        });
+    }
+
+    return areaRect * static_cast<double>(inside) / static_cast<double>(report.samples);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "inside_kernel.h"
+
+enum class BoxCover { Outside, Inside, Boundary };
+
+// Exact box-versus-disk tests: the box misses circle j when its nearest point
+// is outside it and lies inside it when its farthest corner is. Only the
+// candidates are tested; those whose boundary crosses the box are appended
+// to crossing (left untouched when the box is Outside).
+inline BoxCover classify_box(const CircleSoA &c, const int *candidates, int count,
+                             double x0, double x1, double y0, double y1,
+                             std::vector<int> &crossing) {
+    std::size_t mark = crossing.size();
+    for (int k = 0; k < count; ++k) {
+        int j = candidates[k];
+        double nx = std::max(0.0, std::max(x0 - c.x[j], c.x[j] - x1));
+        double ny = std::max(0.0, std::max(y0 - c.y[j], c.y[j] - y1));
+        if (nx * nx + ny * ny > c.r2[j]) {
+            crossing.resize(mark);
+            return BoxCover::Outside;
+        }
+        double fx = std::max(std::fabs(x0 - c.x[j]), std::fabs(x1 - c.x[j]));
+        double fy = std::max(std::fabs(y0 - c.y[j]), std::fabs(y1 - c.y[j]));
+        if (fx * fx + fy * fy > c.r2[j]) crossing.push_back(j);
+    }
+    return crossing.size() == mark ? BoxCover::Inside : BoxCover::Boundary;
+}
+
+// Uniform grid over the sampling rectangle. A cell lying entirely outside some
+// circle is dead; otherwise it keeps only the circles whose boundary crosses
+// it, in the order they appear in the CircleSoA.
+class CircleGrid {
+public:
+    CircleGrid(const CircleSoA &c, double lx, double ly, double w, double h, int cells)
+        : c_(c), lx_(lx), ly_(ly), g_(std::max(1, cells)),
+          inv_cw_(g_ / w), inv_ch_(g_ / h), start_(g_ * g_ + 1, 0), dead_(g_ * g_, 0) {
+        const double cw = w / g_;
+        const double ch = h / g_;
+        const double ex = cw * 1e-9;
+        const double ey = ch * 1e-9;
+        std::vector<int> all(c.size());
+        for (int j = 0; j < c.size(); ++j) all[j] = j;
+        for (int cy = 0; cy < g_; ++cy) {
+            for (int cx = 0; cx < g_; ++cx) {
+                int cell = cy * g_ + cx;
+                double x0 = lx + cx * cw - ex, x1 = lx + (cx + 1) * cw + ex;
+                double y0 = ly + cy * ch - ey, y1 = ly + (cy + 1) * ch + ey;
+                start_[cell] = static_cast<int>(list_.size());
+                if (classify_box(c, all.data(), c.size(), x0, x1, y0, y1, list_) == BoxCover::Outside) {
+                    dead_[cell] = 1;
+                }
+            }
+        }
+        start_[g_ * g_] = static_cast<int>(list_.size());
+    }
+
+    // Boundary cells scale with perimeter, so about sqrt(N) cells per side
+    // keeps the average list short without a quadratic build.
+    static int default_cells(int circles) {
+        int g = static_cast<int>(std::ceil(2.0 * std::sqrt(static_cast<double>(circles))));
+        return std::min(256, std::max(4, g));
+    }
+
+    long long count_inside(const double *px, const double *py, int n) const {
+        long long inside = 0;
+        for (int i = 0; i < n; ++i) {
+            int cx = std::min(g_ - 1, std::max(0, static_cast<int>((px[i] - lx_) * inv_cw_)));
+            int cy = std::min(g_ - 1, std::max(0, static_cast<int>((py[i] - ly_) * inv_ch_)));
+            int cell = cy * g_ + cx;
+            if (dead_[cell]) continue;
+            bool ok = true;
+            for (int k = start_[cell]; k < start_[cell + 1]; ++k) {
+                int j = list_[k];
+                double dx = px[i] - c_.x[j];
+                double dy = py[i] - c_.y[j];
+                if (dx * dx + dy * dy > c_.r2[j]) {
+                    ok = false;
+                    break;
+                }
+            }
+            if (ok) ++inside;
+        }
+        return inside;
+    }
+
+private:
+    const CircleSoA &c_;
+    double lx_, ly_;
+    int g_;
+    double inv_cw_, inv_ch_;
+    std::vector<int> start_;
+    std::vector<int> list_;
+    std::vector<char> dead_;
+};
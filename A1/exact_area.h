@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "inside_kernel.h"
+
+static const double EXACT_EPS = 1e-12;
+
+struct ArcSpan {
+    double lo;
+    double hi;
+};
+
+// Keeps the parts of spans that fall inside the window [lo, hi], which may
+// start below 0 or end past 2*pi; it is folded back into [0, 2*pi) first.
+inline void clip_spans(std::vector<ArcSpan> &spans, double lo, double hi) {
+    const double twoPi = 2.0 * std::acos(-1.0);
+    double len = hi - lo;
+    if (len >= twoPi) return;
+    lo = std::fmod(lo, twoPi);
+    if (lo < 0) lo += twoPi;
+
+    ArcSpan windows[2];
+    int count = 0;
+    if (lo + len <= twoPi) {
+        windows[count++] = {lo, lo + len};
+    } else {
+        windows[count++] = {lo, twoPi};
+        windows[count++] = {0.0, lo + len - twoPi};
+    }
+
+    std::vector<ArcSpan> out;
+    for (const ArcSpan &s : spans) {
+        for (int k = 0; k < count; ++k) {
+            double a = std::max(s.lo, windows[k].lo);
+            double b = std::min(s.hi, windows[k].hi);
+            if (b > a) out.push_back({a, b});
+        }
+    }
+    spans.swap(out);
+}
+
+// Area of the intersection of all disks. The boundary of the (convex) region
+// is made of the arcs of each circle that lie inside every other disk, and
+// Green's theorem turns each counter-clockwise arc into a closed-form term:
+//   1/2 * [r^2 (t2 - t1) + r xc (sin t2 - sin t1) - r yc (cos t2 - cos t1)].
+// Coincident circles are merged first so the same arc is not counted twice;
+// tangency and empty overlaps come out as zero-length arcs.
+inline double intersection_area(const CircleSoA &input) {
+    const double twoPi = 2.0 * std::acos(-1.0);
+    if (input.size() == 0) return 0.0;
+
+    CircleSoA c;
+    for (int i = 0; i < input.size(); ++i) {
+        if (!(input.r[i] > 0)) return 0.0;
+        double scale = std::max(1.0, input.r[i]);
+        bool duplicate = false;
+        for (int j = 0; j < c.size() && !duplicate; ++j) {
+            duplicate = std::fabs(input.x[i] - c.x[j]) <= EXACT_EPS * scale
+                        && std::fabs(input.y[i] - c.y[j]) <= EXACT_EPS * scale
+                        && std::fabs(input.r[i] - c.r[j]) <= EXACT_EPS * scale;
+        }
+        if (!duplicate) c.add(input.x[i], input.y[i], input.r[i]);
+    }
+
+    const int n = c.size();
+    for (int i = 0; i < n; ++i) {
+        for (int j = i + 1; j < n; ++j) {
+            double d = std::hypot(c.x[j] - c.x[i], c.y[j] - c.y[i]);
+            if (d >= c.r[i] + c.r[j] - EXACT_EPS * std::max(c.r[i], c.r[j])) return 0.0;
+        }
+    }
+
+    double area = 0.0;
+    std::vector<ArcSpan> spans;
+    for (int i = 0; i < n; ++i) {
+        spans.assign(1, {0.0, twoPi});
+        for (int j = 0; j < n && !spans.empty(); ++j) {
+            if (j == i) continue;
+            double dx = c.x[j] - c.x[i];
+            double dy = c.y[j] - c.y[i];
+            double d = std::hypot(dx, dy);
+            double tol = EXACT_EPS * std::max(c.r[i], c.r[j]);
+            if (d + c.r[i] <= c.r[j] + tol) continue;
+            if (d + c.r[j] <= c.r[i] + tol) {
+                spans.clear();
+                break;
+            }
+            double cosAlpha = (d * d + c.r[i] * c.r[i] - c.r[j] * c.r[j]) / (2.0 * d * c.r[i]);
+            double alpha = std::acos(std::max(-1.0, std::min(1.0, cosAlpha)));
+            double mid = std::atan2(dy, dx);
+            clip_spans(spans, mid - alpha, mid + alpha);
+        }
+        for (const ArcSpan &s : spans) {
+            double r = c.r[i];
+            area += 0.5 * (r * r * (s.hi - s.lo)
+                           + r * c.x[i] * (std::sin(s.hi) - std::sin(s.lo))
+                           - r * c.y[i] * (std::cos(s.hi) - std::cos(s.lo)));
+        }
+    }
+    return std::max(0.0, area);
+}
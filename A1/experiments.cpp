@@ -1,15 +1,40 @@
 #include <iostream>
 #include <fstream>
 #include <iomanip>
-#include <random>
 #include <cmath>
 #include <algorithm>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "area_estimator.h"
 
 struct Circle {
     double x;
     double y;
     double r;
-    double r2;
+};
+
+struct Rect {
+    double lx, ly, w, h;
+};
+
+struct TrialResult {
+    double estimate;
+    double seconds;
+};
+
+struct Summary {
+    double meanError;
+    double stdDev;
+    double rmse;
+    double p50, p90, p99;
+    double samplesPerSecond;
+    double nsPerSample;
 };
 
 double exact_area() {
@@ -17,19 +42,117 @@ double exact_area() {
     return 0.25 * pi + 1.25 * std::asin(0.8) - 1.0;
 }
 
-int main() {
+TrialResult run_trial(const CircleSoA &soa, const Rect &rect, long long N,
+                      SamplerKind samplerKind, KernelKind kernel, int trial) {
+    std::uint64_t seed = 987654321u + static_cast<std::uint64_t>(trial);
+    auto start = std::chrono::steady_clock::now();
+
+    // One block covering all N samples, on the estimator's own sampling loop.
+    UnitSampler sampler(samplerKind, N, seed, true);
+    long long inside = count_inside_block(
+        [&](const double *px, const double *py, int n) {
+            return count_inside(kernel, soa, px, py, n);
+        },
+        sampler, kernel, rect.lx, rect.ly, rect.w, rect.h, seed, 0, N);
+
+    auto end = std::chrono::steady_clock::now();
+    TrialResult res;
+    res.estimate = rect.w * rect.h * static_cast<double>(inside) / static_cast<double>(N);
+    res.seconds = std::chrono::duration<double>(end - start).count();
+    return res;
+}
+
+double percentile(const std::vector<double> &sorted, double q) {
+    double pos = q * static_cast<double>(sorted.size() - 1);
+    std::size_t lo = static_cast<std::size_t>(pos);
+    std::size_t hi = std::min(sorted.size() - 1, lo + 1);
+    double t = pos - static_cast<double>(lo);
+    return sorted[lo] * (1.0 - t) + sorted[hi] * t;
+}
+
+// Trials are independent streams handed out through an atomic counter, so the
+// error statistics for a configuration do not depend on the thread count.
+Summary run_config(const CircleSoA &soa, const Rect &rect, long long N,
+                   SamplerKind samplerKind, KernelKind kernel,
+                   int trials, int threads, double exact) {
+    std::vector<TrialResult> results(trials);
+    std::atomic<int> next(0);
+    auto worker = [&]() {
+        for (int t = next++; t < trials; t = next++) {
+            results[t] = run_trial(soa, rect, N, samplerKind, kernel, t);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < std::min(threads, trials); ++t) pool.emplace_back(worker);
+    worker();
+    for (auto &th : pool) th.join();
+
+    double sum = 0.0, sumSq = 0.0, seconds = 0.0;
+    std::vector<double> absErr(trials);
+    for (int t = 0; t < trials; ++t) {
+        double e = results[t].estimate - exact;
+        sum += e;
+        sumSq += e * e;
+        seconds += results[t].seconds;
+        absErr[t] = std::fabs(e);
+    }
+    std::sort(absErr.begin(), absErr.end());
+
+    Summary s;
+    s.meanError = sum / trials;
+    s.rmse = std::sqrt(sumSq / trials);
+    s.stdDev = trials > 1
+               ? std::sqrt(std::max(0.0, (sumSq - sum * sum / trials) / (trials - 1)))
+               : 0.0;
+    s.p50 = percentile(absErr, 0.50);
+    s.p90 = percentile(absErr, 0.90);
+    s.p99 = percentile(absErr, 0.99);
+    double total = static_cast<double>(N) * trials;
+    s.samplesPerSecond = total / seconds;
+    s.nsPerSample = seconds * 1e9 / total;
+    return s;
+}
+
+int main(int argc, char **argv) {
     std::ios::sync_with_stdio(false);
     std::cin.tie(nullptr);
 
+    long long minN = 100;
+    long long maxN = 1000000;
+    int perDecade = 4;
+    int trials = 64;
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    const char *outPath = "../results.csv";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--min-n") == 0) minN = std::atoll(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--max-n") == 0) maxN = std::atoll(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--per-decade") == 0) perDecade = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--trials") == 0) trials = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--threads") == 0) threads = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--out") == 0) outPath = argv[i + 1];
+    }
+    if (threads < 1) threads = 1;
+    if (trials < 1) trials = 1;
+    if (perDecade < 1) perDecade = 1;
+    if (minN < 1) minN = 1;
+
     Circle c[3];
     c[0].x = 1.0;  c[0].y = 1.0;  c[0].r = 1.0;
     c[1].x = 1.5;  c[1].y = 2.0;  c[1].r = std::sqrt(5.0) / 2.0;
     c[2].x = 2.0;  c[2].y = 1.5;  c[2].r = std::sqrt(5.0) / 2.0;
+
+    CircleSoA soa;
     for (int i = 0; i < 3; ++i) {
-        c[i].r2 = c[i].r * c[i].r;
+        soa.add(c[i].x, c[i].y, c[i].r);
     }
 
     double S_exact = exact_area();
+    double S_general = intersection_area(soa);
+    if (std::fabs(S_general - S_exact) > 1e-9) {
+        std::cerr << "General exact solver disagrees: " << S_general
+                  << " vs " << S_exact << "\n";
+        return 1;
+    }
 
     double lx_w = 1e18, rx_w = -1e18;
     double ly_w = 1e18, ry_w = -1e18;
@@ -49,58 +172,62 @@ int main() {
         ry_n = std::min(ry_n, c[i].y + c[i].r);
     }
 
-    std::mt19937_64 rng(987654321);
-    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    Rect rects[2] = {
+        {lx_w, ly_w, rx_w - lx_w, ry_w - ly_w},
+        {lx_n, ly_n, rx_n - lx_n, ry_n - ly_n}
+    };
+
+    std::vector<long long> sizes;
+    for (int k = 0;; ++k) {
+        long long N = std::llround(static_cast<double>(minN)
+                                   * std::pow(10.0, static_cast<double>(k) / perDecade));
+        if (N > maxN) break;
+        if (sizes.empty() || N != sizes.back()) sizes.push_back(N);
+    }
 
-    std::ofstream out("../results.csv");
+    std::ofstream out(outPath);
     if (!out) {
-        std::cerr << "Cannot open ../results.csv for writing\n";
+        std::cerr << "Cannot open " << outPath << " for writing\n";
         return 1;
     }
 
-    out << std::fixed << std::setprecision(10);
-    out << "N,type,estimate,abs_error\n";
+    out << "N,type,sampler,kernel,trials,mean_error,std_dev,rmse,"
+           "p50_abs_error,p90_abs_error,p99_abs_error,samples_per_s,ns_per_sample\n";
+
+    SamplerKind samplers[5] = {
+        SamplerKind::Random,
+        SamplerKind::Sobol,
+        SamplerKind::Halton,
+        SamplerKind::Stratified,
+        SamplerKind::Antithetic
+    };
+    KernelKind kernels[3] = {KernelKind::Scalar, KernelKind::Avx2, KernelKind::Avx512};
 
-    for (int N = 100; N <= 10000; N += 500) {
+    for (long long N : sizes) {
         for (int rectType = 0; rectType < 2; ++rectType) {
-            double lx = rectType == 0 ? lx_w : lx_n;
-            double rx = rectType == 0 ? rx_w : rx_n;
-            double ly = rectType == 0 ? ly_w : ly_n;
-            double ry = rectType == 0 ? ry_w : ry_n;
-
-            double w = rx - lx;
-            double h = ry - ly;
-            double areaRect = w * h;
-
-            int inside = 0;
-            for (int i = 0; i < N; ++i) {
-                double x = lx + w * dist(rng);
-                double y = ly + h * dist(rng);
-
-                bool ok = true;
-                for (int j = 0; j < 3; ++j) {
-                    double dx = x - c[j].x;
-                    double dy = y - c[j].y;
-                    if (dx * dx + dy * dy > c[j].r2) {
-                        ok = false;
-                        break;
-                    }
-                }
-                if (ok) {
-                    ++inside;
+            for (int si = 0; si < 5; ++si) {
+                for (int ki = 0; ki < 3; ++ki) {
+                    if (!kernel_supported(kernels[ki])) continue;
+
+                    Summary s = run_config(soa, rects[rectType], N, samplers[si], kernels[ki],
+                                           trials, threads, S_exact);
+
+                    out << std::fixed << std::setprecision(10)
+                        << N << ","
+                        << (rectType == 0 ? "wide" : "narrow") << ","
+                        << sampler_name(samplers[si]) << ","
+                        << kernel_name(kernels[ki]) << ","
+                        << trials << ","
+                        << s.meanError << "," << s.stdDev << "," << s.rmse << ","
+                        << s.p50 << "," << s.p90 << "," << s.p99 << ","
+                        << std::setprecision(0) << s.samplesPerSecond << ","
+                        << std::setprecision(3) << s.nsPerSample << "\n";
                 }
             }
-
-            double estimate =
-                areaRect * static_cast<double>(inside) / static_cast<double>(N);
-            double err = std::fabs(estimate - S_exact);
-
-            out << N << ","
-                << (rectType == 0 ? "wide" : "narrow") << ","
-                << estimate << "," << err << "\n";
         }
+        std::cerr << "N=" << N << " done\n";
     }
 
-    std::cerr << "Done. Results written to ../results.csv\n";
+    std::cerr << "Done. Results written to " << outPath << "\n";
     return 0;
 }
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "../common/simd_dispatch.h"
+
+struct CircleSoA {
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> r;
+    std::vector<double> r2;
+
+    void add(double cx, double cy, double radius) {
+        x.push_back(cx);
+        y.push_back(cy);
+        r.push_back(radius);
+        r2.push_back(radius * radius);
+    }
+
+    int size() const { return static_cast<int>(x.size()); }
+
+    CircleSoA permuted(const std::vector<int> &order) const {
+        CircleSoA out;
+        for (int i : order) out.add(x[i], y[i], r[i]);
+        return out;
+    }
+};
+
+// With many circles the vector kernels stop once every lane has been
+// rejected; checking only every few circles keeps the 3-circle case branchless.
+static const int EARLY_EXIT_STRIDE = 4;
+
+// A point counts as inside unless some circle has dx*dx + dy*dy > r2, the same
+// predicate as the original early-exit loop, evaluated without branches.
+inline long long count_inside_scalar(const CircleSoA &c, const double *px,
+                                     const double *py, int n) {
+    const int m = c.size();
+    long long inside = 0;
+    for (int i = 0; i < n; ++i) {
+        int ok = 1;
+        for (int j = 0; j < m; ++j) {
+            double dx = px[i] - c.x[j];
+            double dy = py[i] - c.y[j];
+            ok &= !(dx * dx + dy * dy > c.r2[j]);
+            if (j % EARLY_EXIT_STRIDE == EARLY_EXIT_STRIDE - 1 && !ok) break;
+        }
+        inside += ok;
+    }
+    return inside;
+}
+
+#ifdef X86_KERNELS
+__attribute__((target("avx2")))
+inline long long count_inside_avx2(const CircleSoA &c, const double *px,
+                                   const double *py, int n) {
+    const int m = c.size();
+    long long inside = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(px + i);
+        __m256d y = _mm256_loadu_pd(py + i);
+        __m256d ok = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        for (int j = 0; j < m; ++j) {
+            __m256d dx = _mm256_sub_pd(x, _mm256_set1_pd(c.x[j]));
+            __m256d dy = _mm256_sub_pd(y, _mm256_set1_pd(c.y[j]));
+            __m256d d2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+            ok = _mm256_and_pd(ok, _mm256_cmp_pd(d2, _mm256_set1_pd(c.r2[j]), _CMP_NGT_UQ));
+            if (j % EARLY_EXIT_STRIDE == EARLY_EXIT_STRIDE - 1 && _mm256_movemask_pd(ok) == 0) break;
+        }
+        inside += __builtin_popcount(_mm256_movemask_pd(ok));
+    }
+    return inside + count_inside_scalar(c, px + i, py + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+inline long long count_inside_avx512(const CircleSoA &c, const double *px,
+                                     const double *py, int n) {
+    const int m = c.size();
+    long long inside = 0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d x = _mm512_loadu_pd(px + i);
+        __m512d y = _mm512_loadu_pd(py + i);
+        __mmask8 ok = 0xFF;
+        for (int j = 0; j < m; ++j) {
+            __m512d dx = _mm512_sub_pd(x, _mm512_set1_pd(c.x[j]));
+            __m512d dy = _mm512_sub_pd(y, _mm512_set1_pd(c.y[j]));
+            __m512d d2 = _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy));
+            ok &= _mm512_cmp_pd_mask(d2, _mm512_set1_pd(c.r2[j]), _CMP_NGT_UQ);
+            if (j % EARLY_EXIT_STRIDE == EARLY_EXIT_STRIDE - 1 && ok == 0) break;
+        }
+        inside += __builtin_popcount(static_cast<unsigned>(ok));
+    }
+    return inside + count_inside_scalar(c, px + i, py + i, n - i);
+}
+#endif
+
+inline long long count_inside(KernelKind k, const CircleSoA &c, const double *px,
+                              const double *py, int n) {
+#ifdef X86_KERNELS
+    if (k == KernelKind::Avx512) return count_inside_avx512(c, px, py, n);
+    if (k == KernelKind::Avx2) return count_inside_avx2(c, px, py, n);
+#endif
+    return count_inside_scalar(c, px, py, n);
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include "circle_grid.h"
+#include "xoshiro.h"
+
+static const int QUADTREE_MAX_DEPTH = 14;
+static const long long QUADTREE_MIN_CELL_SAMPLES = 32;
+static const int QUADTREE_LEAF_CHUNK = 256;
+
+// Refines the rectangle level by level. Cells outside some circle are dropped,
+// cells inside every circle add their area exactly, and only cells the
+// boundary crosses are split further. Refinement stops before the boundary
+// leaves would get fewer than QUADTREE_MIN_CELL_SAMPLES samples each.
+class QuadtreeEstimator {
+public:
+    QuadtreeEstimator(const CircleSoA &c, double lx, double ly, double w, double h,
+                      long long budget)
+        : c_(c), covered_(0.0) {
+        std::vector<int> all(c.size());
+        for (int j = 0; j < c.size(); ++j) all[j] = j;
+
+        Cell root = {lx, ly, w, h, 0, 0};
+        BoxCover cover = classify_box(c, all.data(), c.size(), lx, lx + w, ly, ly + h, pool_);
+        root.count = static_cast<int>(pool_.size());
+        if (cover == BoxCover::Inside) covered_ = w * h;
+        if (cover != BoxCover::Boundary) return;
+        leaves_.push_back(root);
+
+        for (int depth = 0; depth < QUADTREE_MAX_DEPTH; ++depth) {
+            if (static_cast<long long>(leaves_.size()) * 4 * QUADTREE_MIN_CELL_SAMPLES > budget) break;
+
+            std::vector<Cell> next;
+            std::vector<int> nextPool;
+            for (const Cell &p : leaves_) {
+                double hw = 0.5 * p.w;
+                double hh = 0.5 * p.h;
+                for (int q = 0; q < 4; ++q) {
+                    Cell child = {p.x + (q & 1) * hw, p.y + (q >> 1) * hh, hw, hh,
+                                  static_cast<int>(nextPool.size()), 0};
+                    BoxCover cc = classify_box(c, pool_.data() + p.first, p.count,
+                                               child.x, child.x + hw, child.y, child.y + hh,
+                                               nextPool);
+                    if (cc == BoxCover::Inside) covered_ += hw * hh;
+                    if (cc != BoxCover::Boundary) continue;
+                    child.count = static_cast<int>(nextPool.size()) - child.first;
+                    next.push_back(child);
+                }
+            }
+            leaves_.swap(next);
+            pool_.swap(nextPool);
+            if (leaves_.empty()) break;
+        }
+    }
+
+    double covered_area() const { return covered_; }
+
+    int boundary_cells() const { return static_cast<int>(leaves_.size()); }
+
+    double boundary_area() const {
+        double a = 0.0;
+        for (const Cell &cell : leaves_) a += cell.w * cell.h;
+        return a;
+    }
+
+    // Leaves are handed out in fixed chunks, each with its own stream, so the
+    // result for a seed does not depend on the thread count.
+    double estimate(long long budget, std::uint64_t seed, int threads, KernelKind kernel,
+                    double &stdError) const {
+        stdError = 0.0;
+        const int leaves = boundary_cells();
+        if (leaves == 0) return covered_;
+
+        double boundary = boundary_area();
+        std::vector<long long> quota(leaves);
+        long long assigned = 0;
+        for (int i = 0; i < leaves; ++i) {
+            quota[i] = std::max(1LL, static_cast<long long>(
+                static_cast<double>(budget) * leaves_[i].w * leaves_[i].h / boundary));
+            assigned += quota[i];
+        }
+        for (int i = 0; assigned < budget; i = (i + 1) % leaves, ++assigned) ++quota[i];
+
+        std::vector<long long> inside(leaves, 0);
+        int chunks = (leaves + QUADTREE_LEAF_CHUNK - 1) / QUADTREE_LEAF_CHUNK;
+        if (threads < 1) threads = 1;
+        if (threads > chunks) threads = chunks;
+        auto worker = [&](int t) {
+            std::vector<double> u, v;
+            for (int ch = t; ch < chunks; ch += threads) {
+                BulkUniform rng(seed, static_cast<std::uint64_t>(ch), kernel);
+                int end = std::min(leaves, (ch + 1) * QUADTREE_LEAF_CHUNK);
+                for (int i = ch * QUADTREE_LEAF_CHUNK; i < end; ++i) {
+                    int n = static_cast<int>(quota[i]);
+                    u.resize(n);
+                    v.resize(n);
+                    rng.fill(u.data(), n);
+                    rng.fill(v.data(), n);
+                    inside[i] = count_cell(leaves_[i], u.data(), v.data(), n);
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for (int t = 1; t < threads; ++t) pool.emplace_back(worker, t);
+        worker(0);
+        for (auto &th : pool) th.join();
+
+        double area = covered_;
+        double var = 0.0;
+        for (int i = 0; i < leaves; ++i) {
+            double a = leaves_[i].w * leaves_[i].h;
+            double p = static_cast<double>(inside[i]) / static_cast<double>(quota[i]);
+            area += a * p;
+            var += a * a * p * (1.0 - p) / static_cast<double>(quota[i]);
+        }
+        stdError = std::sqrt(var);
+        return area;
+    }
+
+private:
+    struct Cell {
+        double x, y, w, h;
+        int first, count;
+    };
+
+    long long count_cell(const Cell &cell, const double *u, const double *v, int n) const {
+        const int *idx = pool_.data() + cell.first;
+        long long inside = 0;
+        for (int i = 0; i < n; ++i) {
+            double x = cell.x + cell.w * u[i];
+            double y = cell.y + cell.h * v[i];
+            int ok = 1;
+            for (int k = 0; k < cell.count && ok; ++k) {
+                int j = idx[k];
+                double dx = x - c_.x[j];
+                double dy = y - c_.y[j];
+                ok = !(dx * dx + dy * dy > c_.r2[j]);
+            }
+            inside += ok;
+        }
+        return inside;
+    }
+
+    const CircleSoA &c_;
+    double covered_;
+    std::vector<Cell> leaves_;
+    std::vector<int> pool_;
+};
@@ -0,0 +1,69 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+
+#include "xoshiro.h"
+
+static const int BUFFER = 4096;
+
+template <class F>
+double doubles_per_second(long long total, F &&fill, double &sink) {
+    std::vector<double> buf(BUFFER);
+    auto start = std::chrono::steady_clock::now();
+    for (long long done = 0; done < total; done += BUFFER) {
+        fill(buf.data(), BUFFER);
+        sink += buf[BUFFER - 1];
+    }
+    auto end = std::chrono::steady_clock::now();
+    double sec = std::chrono::duration<double>(end - start).count();
+    return static_cast<double>(total) / sec;
+}
+
+int main(int argc, char **argv) {
+    long long total = argc > 1 ? std::atoll(argv[1]) : 200000000LL;
+    double sink = 0.0;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "generator,mdoubles_per_s,speedup\n";
+
+    std::mt19937_64 mt(123456789);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    double base = doubles_per_second(total, [&](double *out, int n) {
+        for (int i = 0; i < n; ++i) out[i] = dist(mt);
+    }, sink);
+    std::cout << "mt19937_64+uniform_real," << base / 1e6 << ",1.00\n";
+
+    Xoshiro256pp x(123456789);
+    double single = doubles_per_second(total, [&](double *out, int n) {
+        for (int i = 0; i < n; ++i) out[i] = x.next_double();
+    }, sink);
+    std::cout << "xoshiro256pp," << single / 1e6 << ',' << single / base << '\n';
+
+    KernelKind kernels[3] = {KernelKind::Scalar, KernelKind::Avx2, KernelKind::Avx512};
+    std::vector<double> reference(BUFFER);
+    BulkUniform(123456789, 0, KernelKind::Scalar).fill(reference.data(), BUFFER);
+    for (int k = 0; k < 3; ++k) {
+        if (!kernel_supported(kernels[k])) continue;
+
+        std::vector<double> check(BUFFER);
+        BulkUniform(123456789, 0, kernels[k]).fill(check.data(), BUFFER);
+        if (check != reference) {
+            std::cerr << "Kernel " << kernel_name(kernels[k])
+                      << " disagrees with the scalar stream\n";
+            return 1;
+        }
+
+        BulkUniform bulk(123456789, 0, kernels[k]);
+        double rate = doubles_per_second(total, [&](double *out, int n) {
+            bulk.fill(out, n);
+        }, sink);
+        std::cout << "bulk_xoshiro256pp_" << kernel_name(kernels[k]) << ','
+                  << rate / 1e6 << ',' << rate / base << '\n';
+    }
+
+    std::cerr << "checksum " << sink << '\n';
+    return 0;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "xoshiro.h"
+
+enum class SamplerKind { Random, Sobol, Halton, Stratified, Antithetic };
+
+inline const char *sampler_name(SamplerKind s) {
+    if (s == SamplerKind::Sobol) return "sobol";
+    if (s == SamplerKind::Halton) return "halton";
+    if (s == SamplerKind::Stratified) return "stratified";
+    if (s == SamplerKind::Antithetic) return "antithetic";
+    return "random";
+}
+
+inline bool parse_sampler(const char *s, SamplerKind &k) {
+    if (std::strcmp(s, "random") == 0) k = SamplerKind::Random;
+    else if (std::strcmp(s, "sobol") == 0) k = SamplerKind::Sobol;
+    else if (std::strcmp(s, "halton") == 0) k = SamplerKind::Halton;
+    else if (std::strcmp(s, "stratified") == 0) k = SamplerKind::Stratified;
+    else if (std::strcmp(s, "antithetic") == 0) k = SamplerKind::Antithetic;
+    else return false;
+    return true;
+}
+
+inline double radical_inverse(std::uint64_t i, std::uint64_t base) {
+    const double inv = 1.0 / static_cast<double>(base);
+    double f = inv;
+    double result = 0.0;
+    while (i > 0) {
+        result += f * static_cast<double>(i % base);
+        i /= base;
+        f *= inv;
+    }
+    return result;
+}
+
+// Points of the unit square addressed by their index in the sequence, so a
+// block of samples can be generated by any thread. Random, stratified jitter
+// and antithetic pairs draw from the caller's block generator; Sobol and
+// Halton are deterministic apart from the optional seed-driven scrambling
+// (a digital XOR shift for Sobol, a Cranley-Patterson rotation for Halton).
+class UnitSampler {
+public:
+    UnitSampler(SamplerKind kind, long long total, std::uint64_t seed, bool scramble)
+        : kind_(kind), strata_(0), shift_x_(0), shift_y_(0), rot_x_(0.0), rot_y_(0.0) {
+        if (kind_ == SamplerKind::Stratified) {
+            strata_ = static_cast<long long>(std::sqrt(static_cast<double>(total)));
+            while (strata_ * strata_ > total) --strata_;
+            while ((strata_ + 1) * (strata_ + 1) <= total) ++strata_;
+        }
+        for (int k = 0; k < 64; ++k) {
+            sobol_x_[k] = 1ull << (63 - k);
+            sobol_y_[k] = k == 0 ? 1ull << 63 : sobol_y_[k - 1] ^ (sobol_y_[k - 1] >> 1);
+        }
+        if (scramble) {
+            Xoshiro256pp g(seed ^ 0x5851f42d4c957f2dull);
+            shift_x_ = g.next();
+            shift_y_ = g.next();
+            rot_x_ = g.next_double();
+            rot_y_ = g.next_double();
+        }
+    }
+
+    SamplerKind kind() const { return kind_; }
+
+    void fill(long long first, int n, double *u, double *v, BulkUniform &rng) const {
+        if (kind_ == SamplerKind::Sobol) fill_sobol(first, n, u, v);
+        else if (kind_ == SamplerKind::Halton) fill_halton(first, n, u, v);
+        else if (kind_ == SamplerKind::Stratified) fill_stratified(first, n, u, v, rng);
+        else if (kind_ == SamplerKind::Antithetic) fill_antithetic(n, u, v, rng);
+        else {
+            rng.fill(u, n);
+            rng.fill(v, n);
+        }
+    }
+
+private:
+    // Gray-code order: each point differs from the previous one by a single
+    // direction number, and the first 2^m points still form a (0, m, 2)-net.
+    void fill_sobol(long long first, int n, double *u, double *v) const {
+        std::uint64_t i = static_cast<std::uint64_t>(first);
+        std::uint64_t gray = i ^ (i >> 1);
+        std::uint64_t x = 0, y = 0;
+        for (int k = 0; gray >> k; ++k) {
+            if ((gray >> k) & 1) {
+                x ^= sobol_x_[k];
+                y ^= sobol_y_[k];
+            }
+        }
+        for (int j = 0; j < n; ++j) {
+            if (j > 0) {
+                int k = __builtin_ctzll(i + j);
+                x ^= sobol_x_[k];
+                y ^= sobol_y_[k];
+            }
+            u[j] = u64_to_unit(x ^ shift_x_);
+            v[j] = u64_to_unit(y ^ shift_y_);
+        }
+    }
+
+    void fill_halton(long long first, int n, double *u, double *v) const {
+        for (int j = 0; j < n; ++j) {
+            std::uint64_t i = static_cast<std::uint64_t>(first + j) + 1;
+            double a = radical_inverse(i, 2) + rot_x_;
+            double b = radical_inverse(i, 3) + rot_y_;
+            u[j] = a >= 1.0 ? a - 1.0 : a;
+            v[j] = b >= 1.0 ? b - 1.0 : b;
+        }
+    }
+
+    // One jittered point per cell of a strata_ x strata_ grid; the few
+    // samples left over past strata_^2 are plain random.
+    void fill_stratified(long long first, int n, double *u, double *v, BulkUniform &rng) const {
+        rng.fill(u, n);
+        rng.fill(v, n);
+        const double inv = strata_ > 0 ? 1.0 / static_cast<double>(strata_) : 0.0;
+        for (int j = 0; j < n; ++j) {
+            long long i = first + j;
+            if (i >= strata_ * strata_) break;
+            u[j] = (static_cast<double>(i % strata_) + u[j]) * inv;
+            v[j] = (static_cast<double>(i / strata_) + v[j]) * inv;
+        }
+    }
+
+    // Blocks and batches start at even indices, so pairs never straddle calls.
+    void fill_antithetic(int n, double *u, double *v, BulkUniform &rng) const {
+        int half = (n + 1) / 2;
+        rng.fill(u, half);
+        rng.fill(v, half);
+        for (int k = half - 1; k >= 0; --k) {
+            double a = u[k];
+            double b = v[k];
+            u[2 * k] = a;
+            v[2 * k] = b;
+            if (2 * k + 1 < n) {
+                u[2 * k + 1] = 1.0 - a;
+                v[2 * k + 1] = 1.0 - b;
+            }
+        }
+    }
+
+    SamplerKind kind_;
+    long long strata_;
+    std::uint64_t sobol_x_[64];
+    std::uint64_t sobol_y_[64];
+    std::uint64_t shift_x_, shift_y_;
+    double rot_x_, rot_y_;
+};
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "../common/simd_dispatch.h"
+
+inline std::uint64_t splitmix64(std::uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+inline std::uint64_t rotl64(std::uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// Top 52 bits go straight into the mantissa of a double in [1, 2).
+inline double u64_to_unit(std::uint64_t x) {
+    std::uint64_t bits = (x >> 12) | 0x3ff0000000000000ull;
+    double d;
+    std::memcpy(&d, &bits, sizeof(d));
+    return d - 1.0;
+}
+
+class Xoshiro256pp {
+public:
+    explicit Xoshiro256pp(std::uint64_t seed = 0) { reseed(seed); }
+
+    void reseed(std::uint64_t seed) {
+        for (int i = 0; i < 4; ++i) {
+            seed += 0x9e3779b97f4a7c15ull;
+            s[i] = splitmix64(seed);
+        }
+    }
+
+    std::uint64_t next() {
+        std::uint64_t result = rotl64(s[0] + s[3], 23) + s[0];
+        std::uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl64(s[3], 45);
+        return result;
+    }
+
+    double next_double() { return u64_to_unit(next()); }
+
+    // Advances by 2^128 steps: consecutive jumps give non-overlapping streams.
+    void jump() {
+        static const std::uint64_t JUMP[4] = {
+            0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull,
+            0xa9582618e03fc9aaull, 0x39abdc4529b1661cull
+        };
+        std::uint64_t t[4] = {0, 0, 0, 0};
+        for (int i = 0; i < 4; ++i) {
+            for (int b = 0; b < 64; ++b) {
+                if (JUMP[i] & (1ull << b)) {
+                    for (int k = 0; k < 4; ++k) t[k] ^= s[k];
+                }
+                next();
+            }
+        }
+        std::memcpy(s, t, sizeof(s));
+    }
+
+    std::uint64_t s[4];
+};
+
+class BulkUniform {
+public:
+    static const int LANES = 8;
+
+    // Streams with different (seed, stream) pairs are seeded independently;
+    // the lanes inside one stream are jump()-separated copies of each other.
+    explicit BulkUniform(std::uint64_t seed, std::uint64_t stream = 0,
+                         KernelKind kernel = detect_kernel())
+        : kernel_(kernel), pending_(LANES) {
+        Xoshiro256pp g(seed ^ splitmix64(stream + 0x632be59bd9b4e019ull));
+        for (int lane = 0; lane < LANES; ++lane) {
+            for (int k = 0; k < 4; ++k) s_[k][lane] = g.s[k];
+            g.jump();
+        }
+    }
+
+    double next() {
+        if (pending_ == LANES) {
+            step(buf_, 1);
+            pending_ = 0;
+        }
+        return buf_[pending_++];
+    }
+
+    // Output i comes from lane i % LANES, so the sequence does not depend on
+    // how the caller splits it into fill() calls or on the kernel used.
+    void fill(double *out, int n) {
+        int i = 0;
+        while (i < n && pending_ < LANES) out[i++] = buf_[pending_++];
+        int groups = (n - i) / LANES;
+        step(out + i, groups);
+        i += groups * LANES;
+        while (i < n) out[i++] = next();
+    }
+
+private:
+    void step(double *out, int groups) {
+#ifdef X86_KERNELS
+        if (kernel_ == KernelKind::Avx512) {
+            step_avx512(out, groups);
+            return;
+        }
+        if (kernel_ == KernelKind::Avx2) {
+            step_avx2(out, groups);
+            return;
+        }
+#endif
+        step_scalar(out, groups);
+    }
+
+    void step_scalar(double *out, int groups) {
+        for (int g = 0; g < groups; ++g) {
+            for (int l = 0; l < LANES; ++l) {
+                std::uint64_t result = rotl64(s_[0][l] + s_[3][l], 23) + s_[0][l];
+                std::uint64_t t = s_[1][l] << 17;
+                s_[2][l] ^= s_[0][l];
+                s_[3][l] ^= s_[1][l];
+                s_[1][l] ^= s_[2][l];
+                s_[0][l] ^= s_[3][l];
+                s_[2][l] ^= t;
+                s_[3][l] = rotl64(s_[3][l], 45);
+                out[g * LANES + l] = u64_to_unit(result);
+            }
+        }
+    }
+
+#ifdef X86_KERNELS
+    __attribute__((target("avx2")))
+    static __m256i rotl_avx2(__m256i x, int k) {
+        return _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - k));
+    }
+
+    __attribute__((target("avx2")))
+    void step_avx2(double *out, int groups) {
+        const __m256i exp_bits = _mm256_set1_epi64x(0x3ff0000000000000ll);
+        const __m256d one = _mm256_set1_pd(1.0);
+        for (int h = 0; h < LANES; h += 4) {
+            __m256i s0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s_[0] + h));
+            __m256i s1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s_[1] + h));
+            __m256i s2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s_[2] + h));
+            __m256i s3 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s_[3] + h));
+            for (int g = 0; g < groups; ++g) {
+                __m256i result = _mm256_add_epi64(rotl_avx2(_mm256_add_epi64(s0, s3), 23), s0);
+                __m256i t = _mm256_slli_epi64(s1, 17);
+                s2 = _mm256_xor_si256(s2, s0);
+                s3 = _mm256_xor_si256(s3, s1);
+                s1 = _mm256_xor_si256(s1, s2);
+                s0 = _mm256_xor_si256(s0, s3);
+                s2 = _mm256_xor_si256(s2, t);
+                s3 = rotl_avx2(s3, 45);
+                __m256i bits = _mm256_or_si256(_mm256_srli_epi64(result, 12), exp_bits);
+                _mm256_storeu_pd(out + g * LANES + h,
+                                 _mm256_sub_pd(_mm256_castsi256_pd(bits), one));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(s_[0] + h), s0);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(s_[1] + h), s1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(s_[2] + h), s2);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(s_[3] + h), s3);
+        }
+    }
+
+    // The maskz forms avoid GCC's -Wmaybe-uninitialized noise on the
+    // unmasked AVX-512 shift/rotate intrinsics.
+    __attribute__((target("avx512f")))
+    void step_avx512(double *out, int groups) {
+        const __mmask8 all = 0xFF;
+        const __m512i exp_bits = _mm512_set1_epi64(0x3ff0000000000000ll);
+        const __m512d one = _mm512_set1_pd(1.0);
+        __m512i s0 = _mm512_loadu_si512(s_[0]);
+        __m512i s1 = _mm512_loadu_si512(s_[1]);
+        __m512i s2 = _mm512_loadu_si512(s_[2]);
+        __m512i s3 = _mm512_loadu_si512(s_[3]);
+        for (int g = 0; g < groups; ++g) {
+            __m512i result = _mm512_add_epi64(
+                _mm512_maskz_rol_epi64(all, _mm512_add_epi64(s0, s3), 23), s0);
+            __m512i t = _mm512_maskz_slli_epi64(all, s1, 17);
+            s2 = _mm512_xor_si512(s2, s0);
+            s3 = _mm512_xor_si512(s3, s1);
+            s1 = _mm512_xor_si512(s1, s2);
+            s0 = _mm512_xor_si512(s0, s3);
+            s2 = _mm512_xor_si512(s2, t);
+            s3 = _mm512_maskz_rol_epi64(all, s3, 45);
+            __m512i bits = _mm512_or_si512(_mm512_maskz_srli_epi64(all, result, 12), exp_bits);
+            _mm512_storeu_pd(out + g * LANES, _mm512_sub_pd(_mm512_castsi512_pd(bits), one));
+        }
+        _mm512_storeu_si512(s_[0], s0);
+        _mm512_storeu_si512(s_[1], s1);
+        _mm512_storeu_si512(s_[2], s2);
+        _mm512_storeu_si512(s_[3], s3);
+    }
+#endif
+
+    KernelKind kernel_;
+    alignas(64) std::uint64_t s_[4][LANES];
+    double buf_[LANES];
+    int pending_;
+};
@@ -1,12 +1,39 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
+
+#include "bottom_up_merge.h"
+#include "parallel_merge_sort.h"
+#include "natural_merge_sort.h"
+#include "simd_sort.h"
+#include "external_sort.h"
+#include "low_memory_merge.h"
+#include "multiway_merge.h"
+#include "../common/fast_io.h"
+#include "../common/cutoff_profile.h"
 
 static const int THRESHOLD = 15;
 
-void insertion_sort(std::vector<long long> &a, int l, int r) {
+// Values of --algo; hybrid is the default top-down merge sort.
+static const char *const ALGOS[] = {
+    "hybrid", "half", "block", "inplace", "bottomup", "multiway",
+    "parallel", "natural", "branchless", "network", "external"
+};
+
+bool known_algo(const char *s) {
+    for (const char *name : ALGOS) {
+        if (std::strcmp(s, name) == 0) return true;
+    }
+    return false;
+}
+
+template <class T>
+void insertion_sort(std::vector<T> &a, int l, int r) {
     for (int i = l + 1; i < r; ++i) {
-        long long x = a[i];
+        T x = a[i];
         int j = i - 1;
         while (j >= l && a[j] > x) {
             a[j + 1] = a[j];
@@ -16,15 +43,18 @@ void insertion_sort(std::vector<long long> &a, int l, int r) {
     }
 }
 
-void merge_sort(std::vector<long long> &a, std::vector<long long> &tmp, int l, int r) {
+// cutoff is THRESHOLD unless the cutoff profile has a measured value for the
+// input's shape (see --calibrate).
+template <class T>
+void merge_sort(std::vector<T> &a, std::vector<T> &tmp, int l, int r, int cutoff) {
     int len = r - l;
-    if (len <= THRESHOLD) {
+    if (len <= cutoff) {
         insertion_sort(a, l, r);
         return;
     }
     int m = l + (r - l) / 2;
-    merge_sort(a, tmp, l, m);
-    merge_sort(a, tmp, m, r);
+    merge_sort(a, tmp, l, m, cutoff);
+    merge_sort(a, tmp, m, r, cutoff);
 
     int i = l;
     int j = m;
@@ -41,23 +71,141 @@ void merge_sort(std::vector<long long> &a, std::vector<long long> &tmp, int l, i
     for (int t = l; t < r; ++t) a[t] = tmp[t];
 }
 
-int main() {
-    std::ios::sync_with_stdio(false);
-    std::cin.tie(nullptr);
+int main(int argc, char **argv) {
+    const char *algo = "hybrid";
+    const char *inputPath = nullptr;
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    KernelKind kernel = detect_kernel();
+    ExternalSortOptions ext;
+    std::string profilePath = default_profile_path();
+    bool calibrate = false;
+    for (int i = 1; i < argc; i += 2) {
+        if (i + 1 == argc) {
+            std::cerr << "Missing value for " << argv[i] << "\n";
+            return 1;
+        }
+        if (std::strcmp(argv[i], "--algo") == 0) {
+            algo = argv[i + 1];
+            if (!known_algo(algo)) {
+                std::cerr << "Unknown algorithm: " << algo << "\n";
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0) threads = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--kernel") == 0) {
+            if (!parse_kernel(argv[i + 1], kernel)) {
+                std::cerr << "Unsupported kernel: " << argv[i + 1] << "\n";
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--memory-mb") == 0) {
+            ext.memoryBytes = static_cast<std::size_t>(std::atoll(argv[i + 1])) << 20;
+        }
+        else if (std::strcmp(argv[i], "--tmp-dir") == 0) ext.tempDir = argv[i + 1];
+        else if (std::strcmp(argv[i], "--input") == 0) inputPath = argv[i + 1];
+        else if (std::strcmp(argv[i], "--profile") == 0) profilePath = argv[i + 1];
+        else if (std::strcmp(argv[i], "--calibrate") == 0) calibrate = std::atoi(argv[i + 1]) != 0;
+        else {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            return 1;
+        }
+    }
+
+    CutoffProfile profile;
+    profile.load(profilePath);
+    if (calibrate) {
+        auto sortWith = [](auto &a, int cutoff) {
+            auto tmp = a;
+            merge_sort(a, tmp, 0, static_cast<int>(a.size()), cutoff);
+        };
+        calibrate_cutoffs<int>(profile, "merge", sortWith);
+        calibrate_cutoffs<long long>(profile, "merge", sortWith);
+        if (!profile.save(profilePath)) {
+            std::cerr << "Cannot write " << profilePath << "\n";
+            return 1;
+        }
+        std::cerr << "Cutoffs saved to " << profilePath << "\n";
+    }
+
+    int fd = open_input(inputPath);
+    if (fd < 0) {
+        std::cerr << "Cannot open " << inputPath << "\n";
+        return 1;
+    }
+    FastInput in(fd);
+    FastOutput out;
 
     int n;
-    if (!(std::cin >> n)) return 0;
+    if (!in.next(n)) return 0;
+
+    // Out-of-core mode: values are streamed from the input into memory-sized
+    // runs and the merged output is streamed to stdout.
+    if (std::strcmp(algo, "external") == 0) {
+        int remaining = n;
+        bool first = true;
+        ExternalSortReport report;
+        const char *err = external_merge_sort(
+            [&](long long &x) {
+                if (remaining == 0 || !in.next(x)) return false;
+                --remaining;
+                return true;
+            },
+            [&profile](std::vector<long long> &chunk, std::vector<long long> &tmp) {
+                int size = static_cast<int>(chunk.size());
+                InputShape shape = classify_shape(chunk.data(), size);
+                int cutoff = profile.get(cutoff_key("merge", "int64", shape), THRESHOLD);
+                merge_sort(chunk, tmp, 0, size, cutoff);
+            },
+            [&](long long x) {
+                if (!first) out.put(' ');
+                first = false;
+                out.put(x);
+            },
+            ext, report);
+        if (err) {
+            std::cerr << err << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
     std::vector<long long> a(n);
-    for (int i = 0; i < n; ++i) std::cin >> a[i];
+    for (int i = 0; i < n; ++i) in.next(a[i]);
 
+    // Only the modes that need a full-size scratch buffer grow tmp; half,
+    // block and inplace allocate n / 2, sqrt(n) and no elements.
     if (n > 1) {
-        std::vector<long long> tmp(n);
-        merge_sort(a, tmp, 0, n);
+        std::vector<long long> tmp;
+        if (std::strcmp(algo, "half") == 0) {
+            merge_sort_half_buffer(a, THRESHOLD);
+        } else if (std::strcmp(algo, "block") == 0) {
+            merge_sort_block(a, block_buffer_size(n), THRESHOLD);
+        } else if (std::strcmp(algo, "inplace") == 0) {
+            merge_sort_block(a, 0, THRESHOLD);
+        } else if (std::strcmp(algo, "bottomup") == 0) {
+            merge_sort_bottom_up(a, tmp, THRESHOLD);
+        } else if (std::strcmp(algo, "multiway") == 0) {
+            merge_sort_multiway<long long, 4>(a, tmp, THRESHOLD);
+        } else if (std::strcmp(algo, "parallel") == 0) {
+            TaskPool pool(threads);
+            parallel_merge_sort(pool, a, tmp, THRESHOLD);
+        } else if (std::strcmp(algo, "natural") == 0) {
+            natural_merge_sort(a, tmp, natural_min_run(n));
+        } else if (std::strcmp(algo, "branchless") == 0) {
+            merge_sort_branchless(a, tmp, THRESHOLD);
+        } else if (std::strcmp(algo, "network") == 0) {
+            network_merge_sort(kernel, a, tmp);
+        } else {
+            InputShape shape = classify_shape(a.data(), n);
+            int cutoff = profile.get(cutoff_key("merge", "int64", shape), THRESHOLD);
+            tmp.resize(n);
+            merge_sort(a, tmp, 0, n, cutoff);
+        }
     }
 
     for (int i = 0; i < n; ++i) {
-        if (i) std::cout << ' ';
-        std::cout << a[i];
+        if (i) out.put(' ');
+        out.put(a[i]);
     }
     return 0;
 }
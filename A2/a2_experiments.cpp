@@ -4,6 +4,49 @@
 #include <chrono>
 #include <fstream>
 #include <algorithm>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <new>
+#include <malloc.h>
+
+#include "bottom_up_merge.h"
+#include "parallel_merge_sort.h"
+#include "natural_merge_sort.h"
+#include "simd_sort.h"
+#include "external_sort.h"
+#include "low_memory_merge.h"
+#include "multiway_merge.h"
+#include "../common/cutoff_profile.h"
+#include "../common/bench_harness.h"
+
+// Heap accounting for the memory comparison: allocations are counted at
+// their malloc_usable_size, so the running total and its peak are exact up
+// to allocator rounding. Kept out of line so GCC does not pair the inlined
+// free() with new at call sites.
+static std::atomic<long long> heap_bytes(0);
+static std::atomic<long long> heap_peak(0);
+
+__attribute__((noinline)) void *operator new(std::size_t size) {
+    void *p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    long long cur = heap_bytes += static_cast<long long>(malloc_usable_size(p));
+    long long peak = heap_peak.load();
+    while (cur > peak && !heap_peak.compare_exchange_weak(peak, cur)) {
+    }
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    if (!p) return;
+    heap_bytes -= static_cast<long long>(malloc_usable_size(p));
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    operator delete(p);
+}
 
 class ArrayGenerator {
 public:
@@ -18,9 +61,8 @@ public:
         reversed_ = random_;
         std::sort(reversed_.begin(), reversed_.end(), std::greater<int>());
 
-        almost_.resize(maxSize_);
-        std::sort(random_.begin(), random_.end());
         almost_ = random_;
+        std::sort(almost_.begin(), almost_.end());
         int swaps = maxSize_ / 20;
         std::uniform_int_distribution<int> pos(0, maxSize_ - 1);
         for (int i = 0; i < swaps; ++i) {
@@ -47,9 +89,10 @@ private:
     std::vector<int> almost_;
 };
 
-void insertion_sort_segment(std::vector<int> &a, int l, int r) {
+template <class T>
+void insertion_sort_segment(std::vector<T> &a, int l, int r) {
     for (int i = l + 1; i < r; ++i) {
-        int x = a[i];
+        T x = a[i];
         int j = i - 1;
         while (j >= l && a[j] > x) {
             a[j + 1] = a[j];
@@ -76,7 +119,9 @@ void merge_sort_std_rec(std::vector<int> &a, std::vector<int> &tmp, int l, int r
     for (int t = l; t < r; ++t) a[t] = tmp[t];
 }
 
-void merge_sort_hybrid_rec(std::vector<int> &a, std::vector<int> &tmp,
+// Top-down hybrid merge sort, the same algorithm as merge_sort in A2.cpp.
+template <class T>
+void merge_sort_hybrid_rec(std::vector<T> &a, std::vector<T> &tmp,
                            int l, int r, int threshold) {
     int len = r - l;
     if (len <= threshold) {
@@ -98,48 +143,263 @@ void merge_sort_hybrid_rec(std::vector<int> &a, std::vector<int> &tmp,
     for (int t = l; t < r; ++t) a[t] = tmp[t];
 }
 
+// Runs registered cases on generated inputs through the benchmark harness.
 class SortTester {
 public:
-    explicit SortTester(const ArrayGenerator &gen) : gen_(gen) {}
+    SortTester(const ArrayGenerator &gen, const BenchOptions &opt, PerfCounters *counters)
+        : gen_(gen), opt_(opt), counters_(counters) {}
 
-    long long measure_merge(ArrayGenerator::Type type, int n, int repeats) {
-        std::vector<int> base;
-        gen_.fill(base, n, type);
-        std::vector<int> a(n);
-        std::vector<int> tmp(n);
-        long long total = 0;
-        for (int rep = 0; rep < repeats; ++rep) {
-            std::copy(base.begin(), base.end(), a.begin());
-            auto start = std::chrono::high_resolution_clock::now();
-            merge_sort_std_rec(a, tmp, 0, n);
-            auto end = std::chrono::high_resolution_clock::now();
-            total += std::chrono::duration_cast<std::chrono::microseconds>(
-                         end - start).count();
+    BenchResult measure(BenchCase &c, ArrayGenerator::Type type, int n) {
+        gen_.fill(base_, n, type);
+        c.load(base_);
+        BenchResult r = run_benchmark(c, opt_, counters_);
+        if (!c.sorted()) std::cerr << c.algorithm << " produced unsorted output\n";
+        return r;
+    }
+
+private:
+    const ArrayGenerator &gen_;
+    BenchOptions opt_;
+    PerfCounters *counters_;
+    std::vector<int> base_;
+};
+
+// Every algorithm of the a2_results sweep. tuned is the profiled cutoff for
+// the shape being measured, 0 when the profile has none.
+std::vector<BenchCase> register_sort_cases(int tuned, const int *thresholds, int count) {
+    std::vector<BenchCase> cases;
+    cases.push_back(sort_case<int>("merge", 0, [](std::vector<int> &a, std::vector<int> &tmp) {
+        merge_sort_std_rec(a, tmp, 0, static_cast<int>(a.size()));
+    }));
+    auto hybrid = [](int thr) {
+        return [thr](std::vector<int> &a, std::vector<int> &tmp) {
+            merge_sort_hybrid_rec(a, tmp, 0, static_cast<int>(a.size()), thr);
+        };
+    };
+    if (tuned > 0) cases.push_back(sort_case<int>("hybrid_tuned", tuned, hybrid(tuned)));
+
+    for (int k = 0; k < count; ++k) {
+        int thr = thresholds[k];
+        cases.push_back(sort_case<int>("hybrid", thr, hybrid(thr)));
+        cases.push_back(sort_case<int>("bottomup", thr,
+            [thr](std::vector<int> &a, std::vector<int> &tmp) { merge_sort_bottom_up(a, tmp, thr); }));
+        cases.push_back(sort_case<int>("natural", thr,
+            [thr](std::vector<int> &a, std::vector<int> &tmp) { natural_merge_sort(a, tmp, thr); }));
+        cases.push_back(sort_case<int>("branchless", thr,
+            [thr](std::vector<int> &a, std::vector<int> &tmp) { merge_sort_branchless(a, tmp, thr); }));
+    }
+
+    // The int32 and int64 networks sort the generated ints widened to T.
+    KernelKind vectorKernels[2] = {KernelKind::Avx2, KernelKind::Avx512};
+    for (KernelKind kernel : vectorKernels) {
+        if (!kernel_supported(kernel)) continue;
+        std::string kname = kernel_name(kernel);
+        cases.push_back(sort_case<int>("network32_" + kname, NETWORK_BLOCK,
+            [kernel](std::vector<int> &a, std::vector<int> &tmp) { network_merge_sort(kernel, a, tmp); }));
+        cases.push_back(sort_case<long long>("network64_" + kname, NETWORK_BLOCK,
+            [kernel](std::vector<long long> &a, std::vector<long long> &tmp) {
+                network_merge_sort(kernel, a, tmp);
+            }));
+    }
+    return cases;
+}
+
+long long measure_parallel(const std::vector<long long> &base, int threads, int repeats) {
+    int n = static_cast<int>(base.size());
+    std::vector<long long> a(n);
+    std::vector<long long> tmp(n);
+    TaskPool pool(threads);
+    long long total = 0;
+    for (int rep = 0; rep < repeats; ++rep) {
+        std::copy(base.begin(), base.end(), a.begin());
+        auto start = std::chrono::high_resolution_clock::now();
+        parallel_merge_sort(pool, a, tmp, 15);
+        auto end = std::chrono::high_resolution_clock::now();
+        total += std::chrono::duration_cast<std::chrono::microseconds>(
+                     end - start).count();
+    }
+    if (!std::is_sorted(a.begin(), a.end())) {
+        std::cerr << "parallel_merge_sort produced unsorted output\n";
+    }
+    return total / repeats;
+}
+
+// Thread-count sweep over random long long arrays from 10^5 up to maxN; the
+// threads=1 row is the baseline for speedup. The default stops at 10^7;
+// 10^8 (--parallel-max-n 100000000) needs 2.4 GB for input, array and tmp.
+void run_parallel_sweep(int maxN, int repeats) {
+    std::ofstream out("a2_parallel.csv");
+    if (!out) {
+        std::cerr << "Cannot open a2_parallel.csv for writing\n";
+        return;
+    }
+    out << "n,threads,time_us,speedup\n";
+
+    int hw = static_cast<int>(std::thread::hardware_concurrency());
+    std::vector<int> threadCounts;
+    for (int t = 1; t < hw; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(std::max(1, hw));
+
+    std::mt19937_64 rng(123456789);
+    for (long long n = 100000; n <= maxN; n *= 10) {
+        std::vector<long long> base(n);
+        for (auto &x : base) x = static_cast<long long>(rng());
+        long long serial = 0;
+        for (int t : threadCounts) {
+            long long us = measure_parallel(base, t, repeats);
+            if (t == 1) serial = us;
+            out << n << ',' << t << ',' << us << ','
+                << (us > 0 ? static_cast<double>(serial) / us : 0.0) << '\n';
+        }
+    }
+}
+
+// Out-of-core sort of dataMb MiB of random long longs under several memory
+// limits; GB/s counts input bytes over the whole run (runs, passes, output).
+void run_external_benchmark(long long dataMb) {
+    std::ofstream out("a2_external.csv");
+    if (!out) {
+        std::cerr << "Cannot open a2_external.csv for writing\n";
+        return;
+    }
+    out << "data_mb,memory_mb,block_kb,runs,merge_passes,seconds,gb_per_s\n";
+
+    const long long count = (dataMb << 20) / static_cast<long long>(sizeof(long long));
+    const int memoryLimits[] = {16, 64, 256};
+    for (int memoryMb : memoryLimits) {
+        ExternalSortOptions opt;
+        opt.memoryBytes = static_cast<std::size_t>(memoryMb) << 20;
+
+        std::mt19937_64 rng(123456789);
+        long long produced = 0;
+        long long emitted = 0;
+        long long prev = 0;
+        bool sorted = true;
+        ExternalSortReport report;
+        const char *err = external_merge_sort(
+            [&](long long &x) {
+                if (produced == count) return false;
+                x = static_cast<long long>(rng());
+                ++produced;
+                return true;
+            },
+            [](std::vector<long long> &chunk, std::vector<long long> &tmp) {
+                merge_sort_bottom_up(chunk, tmp, 15);
+            },
+            [&](long long x) {
+                if (emitted > 0 && x < prev) sorted = false;
+                prev = x;
+                ++emitted;
+            },
+            opt, report);
+        if (err || !sorted || emitted != count) {
+            std::cerr << "External sort failed at " << memoryMb << " MiB: "
+                      << (err ? err : "wrong output") << "\n";
+            continue;
         }
-        return total / repeats;
+        double gb = static_cast<double>(count * sizeof(long long)) / 1e9;
+        out << dataMb << ',' << memoryMb << ',' << (opt.blockBytes >> 10) << ','
+            << report.runs << ',' << report.mergePasses << ','
+            << report.seconds << ',' << gb / report.seconds << '\n';
+    }
+}
+
+// Scratch memory against speed for the stable modes on long long arrays:
+// full (top-down merge sort with an n-element tmp, A2's default), half
+// (n / 2), block (sqrt n) and inplace (none).
+// Scratch is allocated inside the timed call, so peak_extra_bytes is the
+// heap high-water mark above the input itself.
+void run_memory_comparison(int maxN, int repeats) {
+    std::ofstream out("a2_memory.csv");
+    if (!out) {
+        std::cerr << "Cannot open a2_memory.csv for writing\n";
+        return;
     }
+    out << "n,array_type,algorithm,peak_extra_bytes,time_us\n";
 
-    long long measure_hybrid(ArrayGenerator::Type type, int n,
-                             int threshold, int repeats) {
-        std::vector<int> base;
-        gen_.fill(base, n, type);
+    const char *names[4] = {"full", "half", "block", "inplace"};
+    const InputShape shapes[3] = {InputShape::Random, InputShape::Reversed, InputShape::Almost};
+    for (int n = 10000; n <= maxN; n *= 10) {
+        for (InputShape shape : shapes) {
+            std::vector<long long> base;
+            make_shape_input(base, n, shape, 123456789u);
+            std::vector<long long> a(n);
+            for (int algo = 0; algo < 4; ++algo) {
+                long long total = 0;
+                long long peakExtra = 0;
+                for (int rep = 0; rep < repeats; ++rep) {
+                    std::copy(base.begin(), base.end(), a.begin());
+                    long long before = heap_bytes.load();
+                    heap_peak = before;
+                    auto start = std::chrono::high_resolution_clock::now();
+                    if (algo == 0) {
+                        std::vector<long long> tmp(n);
+                        merge_sort_hybrid_rec(a, tmp, 0, n, 15);
+                    } else if (algo == 1) {
+                        merge_sort_half_buffer(a, 15);
+                    } else {
+                        merge_sort_block(a, algo == 2 ? block_buffer_size(n) : 0, 15);
+                    }
+                    auto end = std::chrono::high_resolution_clock::now();
+                    total += std::chrono::duration_cast<std::chrono::microseconds>(
+                                 end - start).count();
+                    peakExtra = std::max(peakExtra, heap_peak.load() - before);
+                }
+                if (!std::is_sorted(a.begin(), a.end())) {
+                    std::cerr << names[algo] << " produced unsorted output\n";
+                }
+                out << n << ',' << shape_name(shape) << ',' << names[algo] << ','
+                    << peakExtra << ',' << total / repeats << '\n';
+            }
+        }
+    }
+}
+
+// Binary merges against cache-block sorting plus 4- and 8-way merges on random
+// int arrays far past MAX_N. passes and bytes_per_element follow the
+// dram_passes model with the same cache block for every algorithm: merge and
+// hybrid copy tmp back after each merge, bottomup and multiway ping-pong.
+void run_multiway_comparison(int maxN) {
+    std::ofstream out("a2_multiway.csv");
+    if (!out) {
+        std::cerr << "Cannot open a2_multiway.csv for writing\n";
+        return;
+    }
+    out << "n,algorithm,passes,bytes_per_element,time_us\n";
+
+    const char *names[5] = {"merge", "hybrid", "bottomup", "multiway4", "multiway8"};
+    const int fanIn[5] = {2, 2, 2, 4, 8};
+    const int block = CACHE_BLOCK_BYTES / static_cast<int>(2 * sizeof(int));
+    std::mt19937 rng(123456789);
+    for (long long n = 100000; n <= maxN; n *= 10) {
+        std::vector<int> base(n);
+        for (auto &x : base) x = static_cast<int>(rng());
         std::vector<int> a(n);
         std::vector<int> tmp(n);
-        long long total = 0;
-        for (int rep = 0; rep < repeats; ++rep) {
-            std::copy(base.begin(), base.end(), a.begin());
-            auto start = std::chrono::high_resolution_clock::now();
-            merge_sort_hybrid_rec(a, tmp, 0, n, threshold);
-            auto end = std::chrono::high_resolution_clock::now();
-            total += std::chrono::duration_cast<std::chrono::microseconds>(
-                         end - start).count();
+        int repeats = n >= 10000000 ? 1 : 3;
+        for (int algo = 0; algo < 5; ++algo) {
+            long long total = 0;
+            for (int rep = 0; rep < repeats; ++rep) {
+                std::copy(base.begin(), base.end(), a.begin());
+                auto start = std::chrono::high_resolution_clock::now();
+                if (algo == 0) merge_sort_std_rec(a, tmp, 0, static_cast<int>(n));
+                else if (algo == 1) merge_sort_hybrid_rec(a, tmp, 0, static_cast<int>(n), 15);
+                else if (algo == 2) merge_sort_bottom_up(a, tmp, 15);
+                else if (algo == 3) merge_sort_multiway<int, 4>(a, tmp, 15);
+                else merge_sort_multiway<int, 8>(a, tmp, 15);
+                auto end = std::chrono::high_resolution_clock::now();
+                total += std::chrono::duration_cast<std::chrono::microseconds>(
+                             end - start).count();
+            }
+            if (!std::is_sorted(a.begin(), a.end())) {
+                std::cerr << names[algo] << " produced unsorted output\n";
+            }
+            int passes = dram_passes(n, block, fanIn[algo], algo < 2);
+            out << n << ',' << names[algo] << ',' << passes << ','
+                << passes * 2 * sizeof(int) << ',' << total / repeats << '\n';
         }
-        return total / repeats;
     }
-
-private:
-    const ArrayGenerator &gen_;
-};
+}
 
 const char *array_type_name(ArrayGenerator::Type t) {
     if (t == ArrayGenerator::Type::Random) return "random";
@@ -147,49 +407,85 @@ const char *array_type_name(ArrayGenerator::Type t) {
     return "almost";
 }
 
-int main() {
+int main(int argc, char **argv) {
+    int parallelMaxN = 10000000;
+    long long externalMb = 256;
+    int memoryMaxN = 1000000;
+    int multiwayMaxN = 100000000;
+    std::string profilePath = default_profile_path();
+    bool json = false;
+    int pinCpu = -1;
+    bool useCounters = true;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--parallel-max-n") == 0) parallelMaxN = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--external-mb") == 0) externalMb = std::atoll(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--profile") == 0) profilePath = argv[i + 1];
+        else if (std::strcmp(argv[i], "--memory-max-n") == 0) memoryMaxN = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--multiway-max-n") == 0) multiwayMaxN = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--format") == 0) json = std::strcmp(argv[i + 1], "json") == 0;
+        else if (std::strcmp(argv[i], "--pin-cpu") == 0) pinCpu = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--counters") == 0) useCounters = std::atoi(argv[i + 1]) != 0;
+    }
+
     const int MAX_N = 100000;
     const int MIN_N = 500;
     const int STEP_N = 1000;
     const int MAX_VALUE = 6000;
-    const int REPEATS = 5;
     const int thresholds[] = {5, 10, 20, 30, 50};
     const int thresholdsCount = sizeof(thresholds) / sizeof(thresholds[0]);
 
+    if (pinCpu >= 0 && !pin_to_cpu(pinCpu)) {
+        std::cerr << "Cannot pin to CPU " << pinCpu << "\n";
+    }
+    PerfCounters perf;
+    if (useCounters && !perf.available()) {
+        std::cerr << "perf_event_open unavailable; counter columns are -1\n";
+    }
+    BenchOptions opt;
+
+    // Cutoffs measured by `A2 --calibrate 1` are swept next to the fixed list
+    // as hybrid_tuned rows.
+    CutoffProfile profile;
+    profile.load(profilePath);
+    const InputShape shapes[3] = {InputShape::Random, InputShape::Reversed, InputShape::Almost};
+
     ArrayGenerator generator(MAX_N, MAX_VALUE);
-    SortTester tester(generator);
+    SortTester tester(generator, opt, useCounters ? &perf : nullptr);
 
-    std::ofstream out("a2_results.csv");
-    if (!out) {
-        std::cerr << "Cannot open a2_results.csv for writing\n";
+    std::string resultsPath = json ? "a2_results.json" : "a2_results.csv";
+    BenchWriter out(resultsPath, json);
+    if (!out.ok()) {
+        std::cerr << "Cannot open " << resultsPath << " for writing\n";
         return 1;
     }
 
-    out << "n,array_type,algorithm,threshold,time_us\n";
-
     ArrayGenerator::Type types[3] = {
         ArrayGenerator::Type::Random,
         ArrayGenerator::Type::Reversed,
         ArrayGenerator::Type::AlmostSorted
     };
 
+    std::vector<BenchCase> cases[3];
+    for (int ti = 0; ti < 3; ++ti) {
+        int tuned = profile.get(cutoff_key("merge", "int32", shapes[ti]), 0);
+        cases[ti] = register_sort_cases(tuned, thresholds, thresholdsCount);
+    }
+
     for (int n = MIN_N; n <= MAX_N; n += STEP_N) {
         for (int ti = 0; ti < 3; ++ti) {
-            ArrayGenerator::Type t = types[ti];
-            const char *tname = array_type_name(t);
-
-            long long t_merge = tester.measure_merge(t, n, REPEATS);
-            out << n << ',' << tname << ",merge,0," << t_merge << '\n';
-
-            for (int k = 0; k < thresholdsCount; ++k) {
-                int thr = thresholds[k];
-                long long t_h = tester.measure_hybrid(t, n, thr, REPEATS);
-                out << n << ',' << tname << ",hybrid," << thr << ','
-                    << t_h << '\n';
+            const char *tname = array_type_name(types[ti]);
+            for (BenchCase &c : cases[ti]) {
+                out.row(n, tname, c, tester.measure(c, types[ti], n));
             }
         }
     }
 
-    std::cerr << "Done. Results written to a2_results.csv\n";
+    run_parallel_sweep(parallelMaxN, 3);
+    if (externalMb > 0) run_external_benchmark(externalMb);
+    run_memory_comparison(memoryMaxN, 3);
+    run_multiway_comparison(multiwayMaxN);
+
+    std::cerr << "Done. Results written to " << resultsPath << ", a2_parallel.csv, "
+                 "a2_external.csv, a2_memory.csv and a2_multiway.csv\n";
     return 0;
 }
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+template <class T>
+void insertion_sort_run(T *a, int l, int r) {
+    for (int i = l + 1; i < r; ++i) {
+        T x = a[i];
+        int j = i - 1;
+        while (j >= l && a[j] > x) {
+            a[j + 1] = a[j];
+            --j;
+        }
+        a[j + 1] = x;
+    }
+}
+
+template <class T>
+void merge_runs(const T *src, T *dst, int l, int m, int r) {
+    int i = l;
+    int j = m;
+    int k = l;
+    while (i < m && j < r) {
+        if (src[i] <= src[j]) dst[k++] = src[i++];
+        else dst[k++] = src[j++];
+    }
+    while (i < m) dst[k++] = src[i++];
+    while (j < r) dst[k++] = src[j++];
+}
+
+// Iterative merge sort: runs of `run` elements are insertion-sorted in place,
+// then each pass merges pairs of runs from one buffer into the other and the
+// buffers swap roles, so there is no copy-back per level. Pairs that are
+// already in order (src[m-1] <= src[m]) are moved without comparisons. At
+// most one final copy is needed when the last pass ends in tmp.
+template <class T>
+void merge_sort_bottom_up(T *a, T *tmp, int n, int run) {
+    if (n <= 1) return;
+    if (run < 1) run = 1;
+
+    for (int l = 0; l < n; l += run) {
+        insertion_sort_run(a, l, std::min(n, l + run));
+    }
+
+    T *src = a;
+    T *dst = tmp;
+    for (long long width = run; width < n; width *= 2) {
+        for (long long l = 0; l < n; l += 2 * width) {
+            int lo = static_cast<int>(l);
+            int m = static_cast<int>(std::min<long long>(n, l + width));
+            int r = static_cast<int>(std::min<long long>(n, l + 2 * width));
+            if (m >= r || src[m - 1] <= src[m]) {
+                std::copy(src + lo, src + r, dst + lo);
+            } else {
+                merge_runs(src, dst, lo, m, r);
+            }
+        }
+        std::swap(src, dst);
+    }
+    if (src != a) std::copy(src, src + n, a);
+}
+
+template <class T>
+void merge_sort_bottom_up(std::vector<T> &a, std::vector<T> &tmp, int run) {
+    int n = static_cast<int>(a.size());
+    if (static_cast<int>(tmp.size()) < n) tmp.resize(n);
+    merge_sort_bottom_up(a.data(), tmp.data(), n, run);
+}
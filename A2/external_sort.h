@@ -0,0 +1,400 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <future>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+static const std::size_t IO_ALIGNMENT = 4096;
+static const std::size_t MIN_IO_BLOCK = 64 * 1024;
+
+struct ExternalSortOptions {
+    std::size_t memoryBytes = 256u << 20;
+    std::size_t blockBytes = 1u << 20;
+    std::string tempDir = "/tmp";
+};
+
+struct ExternalSortReport {
+    long long elements = 0;
+    int runs = 0;
+    int mergePasses = 0;
+    double seconds = 0.0;
+};
+
+class AlignedBuffer {
+public:
+    explicit AlignedBuffer(std::size_t bytes) : data_(nullptr) {
+        void *p = nullptr;
+        if (posix_memalign(&p, IO_ALIGNMENT, bytes) == 0) data_ = static_cast<char *>(p);
+    }
+    ~AlignedBuffer() { std::free(data_); }
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+    char *data() const { return data_; }
+
+private:
+    char *data_;
+};
+
+// Unnamed temporary file: created with mkstemp and unlinked at once, so the
+// space is released when the descriptor closes, even after a crash.
+class RunFile {
+public:
+    explicit RunFile(const std::string &dir) : fd_(-1), size_(0) {
+        std::string path = dir + "/a2_run_XXXXXX";
+        std::vector<char> name(path.begin(), path.end());
+        name.push_back('\0');
+        fd_ = mkstemp(name.data());
+        if (fd_ >= 0) {
+            unlink(name.data());
+            posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+    }
+    ~RunFile() {
+        if (fd_ >= 0) close(fd_);
+    }
+    RunFile(const RunFile &) = delete;
+    RunFile &operator=(const RunFile &) = delete;
+
+    bool ok() const { return fd_ >= 0; }
+    int fd() const { return fd_; }
+    long long size() const { return size_; }
+    void set_size(long long bytes) { size_ = bytes; }
+
+private:
+    int fd_;
+    long long size_;
+};
+
+inline bool write_fully(int fd, const char *p, std::size_t bytes, long long offset) {
+    while (bytes > 0) {
+        ssize_t w = pwrite(fd, p, bytes, offset);
+        if (w <= 0) return false;
+        p += w;
+        bytes -= static_cast<std::size_t>(w);
+        offset += w;
+    }
+    return true;
+}
+
+inline long long read_fully(int fd, char *p, std::size_t bytes, long long offset) {
+    long long total = 0;
+    while (bytes > 0) {
+        ssize_t r = pread(fd, p + total, bytes, offset + total);
+        if (r < 0) return -1;
+        if (r == 0) break;
+        total += r;
+        bytes -= static_cast<std::size_t>(r);
+    }
+    return total;
+}
+
+// Appends long longs to a run file through two aligned blocks: while one
+// block is written in the background the caller fills the other.
+class RunWriter {
+public:
+    RunWriter(RunFile &file, std::size_t blockBytes)
+        : file_(file), cap_(blockBytes / sizeof(long long)),
+          fill_(0), cur_(0), offset_(0), failed_(false) {
+        buf_[0] = new AlignedBuffer(blockBytes);
+        buf_[1] = new AlignedBuffer(blockBytes);
+        failed_ = buf_[0]->data() == nullptr || buf_[1]->data() == nullptr;
+    }
+    ~RunWriter() {
+        if (pending_.valid()) pending_.wait();
+        delete buf_[0];
+        delete buf_[1];
+    }
+    RunWriter(const RunWriter &) = delete;
+    RunWriter &operator=(const RunWriter &) = delete;
+
+    void put(long long x) {
+        reinterpret_cast<long long *>(buf_[cur_]->data())[fill_++] = x;
+        if (fill_ == cap_) flush();
+    }
+
+    // Waits for outstanding writes; false if any write failed.
+    bool finish() {
+        if (fill_ > 0) flush();
+        if (pending_.valid() && !pending_.get()) failed_ = true;
+        file_.set_size(offset_);
+        return !failed_;
+    }
+
+private:
+    void flush() {
+        if (pending_.valid() && !pending_.get()) failed_ = true;
+        std::size_t bytes = fill_ * sizeof(long long);
+        int fd = file_.fd();
+        const char *p = buf_[cur_]->data();
+        long long offset = offset_;
+        pending_ = std::async(std::launch::async,
+                              [=] { return write_fully(fd, p, bytes, offset); });
+        offset_ += static_cast<long long>(bytes);
+        cur_ ^= 1;
+        fill_ = 0;
+    }
+
+    RunFile &file_;
+    std::size_t cap_;
+    std::size_t fill_;
+    int cur_;
+    long long offset_;
+    bool failed_;
+    AlignedBuffer *buf_[2];
+    std::future<bool> pending_;
+};
+
+// Sequential reader of a run file with one block of read-ahead: the next
+// block is requested as soon as the current one is handed out.
+class RunReader {
+public:
+    RunReader(const RunFile &file, std::size_t blockBytes)
+        : fd_(file.fd()), size_(file.size()), blockBytes_(blockBytes),
+          offset_(0), pos_(0), count_(0), cur_(0), failed_(false) {
+        buf_[0] = new AlignedBuffer(blockBytes);
+        buf_[1] = new AlignedBuffer(blockBytes);
+        failed_ = buf_[0]->data() == nullptr || buf_[1]->data() == nullptr;
+        if (!failed_) request(1);
+    }
+    ~RunReader() {
+        if (pending_.valid()) pending_.wait();
+        delete buf_[0];
+        delete buf_[1];
+    }
+    RunReader(const RunReader &) = delete;
+    RunReader &operator=(const RunReader &) = delete;
+
+    bool failed() const { return failed_; }
+
+    bool next(long long &x) {
+        if (pos_ == count_ && !advance()) return false;
+        x = reinterpret_cast<const long long *>(buf_[cur_]->data())[pos_++];
+        return true;
+    }
+
+private:
+    void request(int which) {
+        if (offset_ >= size_) return;
+        std::size_t bytes = static_cast<std::size_t>(
+            std::min<long long>(static_cast<long long>(blockBytes_), size_ - offset_));
+        int fd = fd_;
+        char *p = buf_[which]->data();
+        long long offset = offset_;
+        pending_ = std::async(std::launch::async,
+                              [=] { return read_fully(fd, p, bytes, offset); });
+        offset_ += static_cast<long long>(bytes);
+    }
+
+    bool advance() {
+        if (!pending_.valid()) return false;
+        long long got = pending_.get();
+        if (got < 0 || got % static_cast<long long>(sizeof(long long)) != 0) {
+            failed_ = true;
+            return false;
+        }
+        cur_ ^= 1;
+        pos_ = 0;
+        count_ = static_cast<std::size_t>(got) / sizeof(long long);
+        request(cur_ ^ 1);
+        return count_ > 0;
+    }
+
+    int fd_;
+    long long size_;
+    std::size_t blockBytes_;
+    long long offset_;
+    std::size_t pos_;
+    std::size_t count_;
+    int cur_;
+    bool failed_;
+    AlignedBuffer *buf_[2];
+    std::future<long long> pending_;
+};
+
+// Tournament tree of losers over k sources: tree_[0] holds the overall
+// winner and each internal node the loser of its match, so replacing the
+// winner replays one leaf-to-root path of log2(k) comparisons. Exhausted
+// sources lose every match; ties go to the lower source index.
+class LoserTree {
+public:
+    explicit LoserTree(int k) : k_(k), tree_(k, -1), key_(k), live_(k, 0) {}
+
+    void set(int i, bool live, long long key) {
+        live_[i] = live;
+        key_[i] = key;
+    }
+
+    void build() {
+        std::fill(tree_.begin(), tree_.end(), -1);
+        for (int i = 0; i < k_; ++i) replay(i);
+    }
+
+    bool empty() const { return !live_[winner()]; }
+    int winner() const { return k_ == 1 ? 0 : tree_[0]; }
+    long long top() const { return key_[winner()]; }
+
+    // Replaces the winner's key (or marks it exhausted) and restores the tree.
+    void replace_top(bool live, long long key) {
+        int w = winner();
+        set(w, live, key);
+        replay(w);
+    }
+
+private:
+    bool beats(int a, int b) const {
+        if (!live_[b]) return live_[a] || a < b;
+        if (!live_[a]) return false;
+        return key_[a] < key_[b] || (key_[a] == key_[b] && a < b);
+    }
+
+    void replay(int leaf) {
+        if (k_ == 1) return;
+        int cand = leaf;
+        for (int node = (leaf + k_) / 2; node > 0; node /= 2) {
+            if (tree_[node] == -1) {
+                tree_[node] = cand;
+                return;
+            }
+            if (beats(tree_[node], cand)) std::swap(tree_[node], cand);
+        }
+        tree_[0] = cand;
+    }
+
+    int k_;
+    std::vector<int> tree_;
+    std::vector<long long> key_;
+    std::vector<char> live_;
+};
+
+// Merges runs[first, last) into emit(x) with a loser tree.
+template <class Sink>
+const char *merge_run_files(std::vector<RunFile *> &runs, int first, int last,
+                            std::size_t blockBytes, Sink emit) {
+    int k = last - first;
+    std::vector<RunReader *> readers;
+    for (int i = first; i < last; ++i) readers.push_back(new RunReader(*runs[i], blockBytes));
+    LoserTree tree(k);
+    for (int i = 0; i < k; ++i) {
+        long long x = 0;
+        bool live = readers[i]->next(x);
+        tree.set(i, live, x);
+    }
+    tree.build();
+    while (!tree.empty()) {
+        int w = tree.winner();
+        emit(tree.top());
+        long long x = 0;
+        bool live = readers[w]->next(x);
+        tree.replace_top(live, x);
+    }
+    const char *err = nullptr;
+    for (RunReader *r : readers) {
+        if (r->failed()) err = "Reading a run file failed";
+        delete r;
+    }
+    return err;
+}
+
+// Out-of-core sort. next(x) yields the input one value at a time, sortChunk
+// sorts a vector in memory given a scratch vector of the same size, and
+// emit(x) receives the sorted output. A chunk and its scratch take the whole
+// memory budget; during merging the budget is split into two blocks per
+// input run plus two for the output, which bounds the fan-in. When there are
+// more runs than that, intermediate passes merge groups into longer runs.
+template <class Source, class Sorter, class Sink>
+const char *external_merge_sort(Source next, Sorter sortChunk, Sink emit,
+                                const ExternalSortOptions &opt, ExternalSortReport &report) {
+    auto start = std::chrono::steady_clock::now();
+    report = ExternalSortReport();
+
+    std::size_t block = std::max(MIN_IO_BLOCK, opt.blockBytes / IO_ALIGNMENT * IO_ALIGNMENT);
+    if (opt.memoryBytes < 8 * block) return "Memory limit must be at least eight I/O blocks";
+    std::size_t chunkElems = std::min<std::size_t>(opt.memoryBytes / (2 * sizeof(long long)),
+                                                   1u << 30);
+    int fanIn = static_cast<int>(std::min<std::size_t>(opt.memoryBytes / (2 * block) - 1, 1024));
+
+    std::vector<RunFile *> runs;
+    auto cleanup = [&runs] {
+        for (RunFile *f : runs) delete f;
+        runs.clear();
+    };
+
+    std::vector<long long> chunk;
+    std::vector<long long> tmp;
+    chunk.reserve(chunkElems);
+    bool more = true;
+    while (more) {
+        chunk.clear();
+        long long x;
+        while (chunk.size() < chunkElems && (more = next(x))) chunk.push_back(x);
+        if (chunk.empty()) break;
+        report.elements += static_cast<long long>(chunk.size());
+        tmp.resize(chunk.size());
+        sortChunk(chunk, tmp);
+
+        if (!more && runs.empty()) {
+            for (long long v : chunk) emit(v);
+            report.runs = 1;
+            report.seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+            return nullptr;
+        }
+        RunFile *file = new RunFile(opt.tempDir);
+        runs.push_back(file);
+        if (!file->ok()) {
+            cleanup();
+            return "Cannot create a run file in the temporary directory";
+        }
+        RunWriter writer(*file, block);
+        for (long long v : chunk) writer.put(v);
+        if (!writer.finish()) {
+            cleanup();
+            return "Writing a run file failed";
+        }
+    }
+    std::vector<long long>().swap(chunk);
+    std::vector<long long>().swap(tmp);
+    report.runs = static_cast<int>(runs.size());
+
+    while (static_cast<int>(runs.size()) > fanIn) {
+        std::vector<RunFile *> merged;
+        for (int first = 0; first < static_cast<int>(runs.size()); first += fanIn) {
+            int last = std::min(static_cast<int>(runs.size()), first + fanIn);
+            RunFile *out = new RunFile(opt.tempDir);
+            merged.push_back(out);
+            const char *err = out->ok() ? nullptr
+                                        : "Cannot create a run file in the temporary directory";
+            if (!err) {
+                RunWriter writer(*out, block);
+                err = merge_run_files(runs, first, last, block,
+                                      [&writer](long long v) { writer.put(v); });
+                if (!writer.finish() && !err) err = "Writing a run file failed";
+            }
+            if (err) {
+                for (RunFile *f : merged) delete f;
+                cleanup();
+                return err;
+            }
+        }
+        cleanup();
+        runs.swap(merged);
+        ++report.mergePasses;
+    }
+
+    const char *err = nullptr;
+    if (!runs.empty()) {
+        err = merge_run_files(runs, 0, static_cast<int>(runs.size()), block, emit);
+        ++report.mergePasses;
+    }
+    cleanup();
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return err;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "bottom_up_merge.h"
+
+// Stable merge of a[l, m) and a[m, r) with the left run copied to buf, which
+// needs only m - l elements; output never overtakes the unread right run.
+template <class T>
+void merge_left_buffered(T *a, int l, int m, int r, T *buf) {
+    T *bufEnd = std::copy(a + l, a + m, buf);
+    T *i = buf;
+    T *j = a + m;
+    T *out = a + l;
+    T *end = a + r;
+    while (i < bufEnd && j < end) {
+        if (*j < *i) *out++ = *j++;
+        else *out++ = *i++;
+    }
+    std::copy(i, bufEnd, out);
+}
+
+// Mirror image: the right run goes to buf and the merge runs backwards.
+template <class T>
+void merge_right_buffered(T *a, int l, int m, int r, T *buf) {
+    T *bufEnd = std::copy(a + m, a + r, buf);
+    T *i = a + m;
+    T *j = bufEnd;
+    T *out = a + r;
+    while (i > a + l && j > buf) {
+        if (*(j - 1) < *(i - 1)) *--out = *--i;
+        else *--out = *--j;
+    }
+    std::copy_backward(buf, j, out);
+}
+
+template <class T>
+void merge_sort_half_rec(T *a, int l, int r, T *buf, int cutoff) {
+    if (r - l <= cutoff) {
+        insertion_sort_run(a, l, r);
+        return;
+    }
+    int m = l + (r - l) / 2;
+    merge_sort_half_rec(a, l, m, buf, cutoff);
+    merge_sort_half_rec(a, m, r, buf, cutoff);
+    if (a[m] < a[m - 1]) merge_left_buffered(a, l, m, r, buf);
+}
+
+// Top-down hybrid merge sort whose only scratch is the left half: n / 2
+// elements instead of n.
+template <class T>
+void merge_sort_half_buffer(std::vector<T> &a, int cutoff) {
+    int n = static_cast<int>(a.size());
+    if (n <= 1) return;
+    std::vector<T> buf(n / 2);
+    merge_sort_half_rec(a.data(), 0, n, buf.data(), cutoff);
+}
+
+// Stable merge with a buffer of any size, including zero. Runs that fit in
+// buf are merged through it; otherwise the longer run is cut in half, the
+// matching cut in the other run is found by binary search, the middle is
+// rotated so both pieces are in place, and each side is merged recursively.
+// Small buffers cover the bottom levels, so an O(sqrt n) buffer keeps most of
+// the work linear while the top levels pay O(n log n) per merge in moves.
+template <class T>
+void merge_adaptive(T *a, int l, int m, int r, T *buf, int bufSize) {
+    if (l >= m || m >= r || !(a[m] < a[m - 1])) return;
+    int n1 = m - l;
+    int n2 = r - m;
+    if (n1 <= bufSize && n1 <= n2) {
+        merge_left_buffered(a, l, m, r, buf);
+        return;
+    }
+    if (n2 <= bufSize) {
+        merge_right_buffered(a, l, m, r, buf);
+        return;
+    }
+    if (n1 + n2 == 2) {
+        std::swap(a[l], a[m]);
+        return;
+    }
+    int cut1;
+    int cut2;
+    if (n1 > n2) {
+        cut1 = l + n1 / 2;
+        cut2 = static_cast<int>(std::lower_bound(a + m, a + r, a[cut1]) - a);
+    } else {
+        cut2 = m + n2 / 2;
+        cut1 = static_cast<int>(std::upper_bound(a + l, a + m, a[cut2]) - a);
+    }
+    int mid = cut1 + (cut2 - m);
+    std::rotate(a + cut1, a + m, a + cut2);
+    merge_adaptive(a, l, cut1, mid, buf, bufSize);
+    merge_adaptive(a, mid, cut2, r, buf, bufSize);
+}
+
+template <class T>
+void merge_sort_adaptive_rec(T *a, int l, int r, T *buf, int bufSize, int cutoff) {
+    if (r - l <= cutoff) {
+        insertion_sort_run(a, l, r);
+        return;
+    }
+    int m = l + (r - l) / 2;
+    merge_sort_adaptive_rec(a, l, m, buf, bufSize, cutoff);
+    merge_sort_adaptive_rec(a, m, r, buf, bufSize, cutoff);
+    merge_adaptive(a, l, m, r, buf, bufSize);
+}
+
+// Stable merge sort with a bufSize-element scratch buffer; pass
+// block_buffer_size(n) for the O(sqrt n) mode or 0 for a fully in-place sort.
+template <class T>
+void merge_sort_block(std::vector<T> &a, int bufSize, int cutoff) {
+    int n = static_cast<int>(a.size());
+    if (n <= 1) return;
+    if (bufSize < 0) bufSize = 0;
+    std::vector<T> buf(bufSize);
+    merge_sort_adaptive_rec(a.data(), 0, n, buf.data(), bufSize, cutoff);
+}
+
+inline int block_buffer_size(int n) {
+    return static_cast<int>(std::sqrt(static_cast<double>(n))) + 1;
+}
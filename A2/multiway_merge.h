@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#include "bottom_up_merge.h"
+
+// Bytes of a block sorted entirely in cache: the block and its scratch half
+// of tmp together fit a 512 KiB L2.
+static const int CACHE_BLOCK_BYTES = 1 << 18;
+
+// K-way merge of the runs [cur[i], end[i]) into out with a loser tree of K
+// leaves (K a power of two; unused leaves are empty runs). tree[0] is the
+// current winner and tree[1..K-1] the losers of each match, so every output
+// element costs log2(K) comparisons along one leaf-to-root path. Run heads
+// are cached in key[]; an exhausted run holds the largest T and is flagged in
+// done[], so it loses even to a live run holding that value. Matches are
+// decided without branches: key first, then done, then the lower run index,
+// which keeps the merge stable. T must be an arithmetic type.
+template <class T, int K>
+void multiway_merge(const T **cur, const T **end, T *out) {
+    T key[K];
+    int done[K];
+    long long total = 0;
+    for (int i = 0; i < K; ++i) {
+        done[i] = cur[i] == end[i];
+        key[i] = done[i] ? std::numeric_limits<T>::max() : *cur[i];
+        total += end[i] - cur[i];
+    }
+    auto beats = [&](int x, int y) -> bool {
+        int lt = key[x] < key[y];
+        int ge = !(key[y] < key[x]);
+        int tie = (done[x] < done[y]) | ((done[x] == done[y]) & (x < y));
+        return lt | (ge & tie);
+    };
+
+    int tree[K];
+    int winner[2 * K];
+    for (int i = 0; i < K; ++i) winner[K + i] = i;
+    for (int node = K - 1; node > 0; --node) {
+        int a = winner[2 * node];
+        int b = winner[2 * node + 1];
+        if (beats(a, b)) {
+            winner[node] = a;
+            tree[node] = b;
+        } else {
+            winner[node] = b;
+            tree[node] = a;
+        }
+    }
+    tree[0] = winner[1];
+
+    for (long long t = 0; t < total; ++t) {
+        int w = tree[0];
+        *out++ = key[w];
+        if (++cur[w] == end[w]) {
+            done[w] = 1;
+            key[w] = std::numeric_limits<T>::max();
+        } else {
+            key[w] = *cur[w];
+        }
+        for (int node = (w + K) / 2; node > 0; node /= 2) {
+            int other = tree[node];
+            bool swap = beats(other, w);
+            tree[node] = swap ? w : other;
+            w = swap ? other : w;
+        }
+        tree[0] = w;
+    }
+}
+
+// Sorts cache-sized blocks with merge_sort_bottom_up, then merges K runs at a
+// time between a and tmp. Each merge pass streams the whole array once, so
+// the out-of-cache passes drop from log2(n / block) to log_K(n / block).
+template <class T, int K>
+void merge_sort_multiway(std::vector<T> &a, std::vector<T> &tmp, int cutoff) {
+    int n = static_cast<int>(a.size());
+    if (n <= 1) return;
+    if (static_cast<int>(tmp.size()) < n) tmp.resize(n);
+    int block = std::max(cutoff, CACHE_BLOCK_BYTES / static_cast<int>(2 * sizeof(T)));
+
+    for (int l = 0; l < n; l += block) {
+        int len = std::min(block, n - l);
+        merge_sort_bottom_up(a.data() + l, tmp.data() + l, len, cutoff);
+    }
+
+    T *src = a.data();
+    T *dst = tmp.data();
+    for (long long width = block; width < n; width *= K) {
+        for (long long l = 0; l < n; l += width * K) {
+            const T *cur[K];
+            const T *end[K];
+            for (int i = 0; i < K; ++i) {
+                long long lo = std::min<long long>(n, l + i * width);
+                long long hi = std::min<long long>(n, lo + width);
+                cur[i] = src + lo;
+                end[i] = src + hi;
+            }
+            if (end[0] == src + n) std::copy(cur[0], end[0], dst + l);
+            else multiway_merge<T, K>(cur, end, dst + l);
+        }
+        std::swap(src, dst);
+    }
+    if (src != a.data()) std::copy(src, src + n, a.data());
+}
+
+// Full passes over DRAM under a simple model: the block phase reads and
+// writes the array once, every merge level above the cache block is one more
+// pass, and a recursive sort's copy-back doubles each level. Bytes moved per
+// element are passes * 2 * sizeof(T).
+inline int merge_levels_above(long long n, long long block, int fanIn) {
+    int levels = 0;
+    for (long long width = block; width < n; width *= fanIn) ++levels;
+    return levels;
+}
+
+inline int dram_passes(long long n, long long block, int fanIn, bool copyBack) {
+    int levels = merge_levels_above(n, block, fanIn);
+    if (copyBack) return 1 + 2 * levels;
+    return 1 + levels + (levels % 2);
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "bottom_up_merge.h"
+
+static const int MIN_GALLOP = 7;
+
+// Elements of base[0, n) that are <= key (strict = false) or < key
+// (strict = true), found by doubling from the left and then bisecting, so a
+// short answer costs O(log answer) comparisons.
+template <class T>
+int gallop_count(const T &key, const T *base, int n, bool strict) {
+    auto before = [&](const T &x) { return strict ? x < key : x <= key; };
+    int lo = 0;
+    int hi = 1;
+    while (hi <= n && before(base[hi - 1])) {
+        lo = hi;
+        hi = hi * 2 + 1;
+    }
+    if (hi > n) hi = n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (before(base[mid])) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Stable in-place merge of a[lo, mid) and a[mid, hi) through tmp. The prefix
+// of the left run that is <= a[mid] and the suffix of the right run that is
+// >= a[mid - 1] are already in position and are skipped. When one side wins
+// MIN_GALLOP times in a row the merge switches to galloping, copying whole
+// blocks found by gallop_count.
+template <class T>
+void merge_galloping(T *a, int lo, int mid, int hi, T *tmp) {
+    lo += gallop_count(a[mid], a + lo, mid - lo, false);
+    if (lo == mid) return;
+    hi = mid + gallop_count(a[mid - 1], a + mid, hi - mid, true);
+    if (mid == hi) return;
+
+    int na = mid - lo;
+    std::copy(a + lo, a + mid, tmp);
+    int i = 0;
+    int j = mid;
+    int k = lo;
+    while (i < na && j < hi) {
+        int winsA = 0;
+        int winsB = 0;
+        while (i < na && j < hi && winsA < MIN_GALLOP && winsB < MIN_GALLOP) {
+            if (a[j] < tmp[i]) {
+                a[k++] = a[j++];
+                ++winsB;
+                winsA = 0;
+            } else {
+                a[k++] = tmp[i++];
+                ++winsA;
+                winsB = 0;
+            }
+        }
+        while (i < na && j < hi) {
+            int runA = gallop_count(a[j], tmp + i, na - i, false);
+            std::copy(tmp + i, tmp + i + runA, a + k);
+            i += runA;
+            k += runA;
+            if (i >= na) break;
+            a[k++] = a[j++];
+            if (j >= hi) break;
+
+            int runB = gallop_count(tmp[i], a + j, hi - j, true);
+            std::copy(a + j, a + j + runB, a + k);
+            j += runB;
+            k += runB;
+            if (j >= hi) break;
+            a[k++] = tmp[i++];
+
+            if (runA < MIN_GALLOP && runB < MIN_GALLOP) break;
+        }
+    }
+    std::copy(tmp + i, tmp + na, a + k);
+}
+
+// Length of the natural run starting at lo. A descending run is reversed in
+// place; it may contain equal neighbours (reversed input with duplicates), so
+// each block of equal keys is reversed back afterwards to stay stable.
+template <class T>
+int natural_run(T *a, int lo, int n) {
+    int i = lo + 1;
+    if (i == n) return 1;
+    if (a[i] < a[i - 1]) {
+        bool ties = false;
+        while (i < n && a[i] <= a[i - 1]) {
+            ties = ties || !(a[i] < a[i - 1]);
+            ++i;
+        }
+        std::reverse(a + lo, a + i);
+        for (int b = lo; ties && b < i;) {
+            int e = b + 1;
+            while (e < i && !(a[b] < a[e])) ++e;
+            std::reverse(a + b, a + e);
+            b = e;
+        }
+    } else {
+        while (i < n && a[i] >= a[i - 1]) ++i;
+    }
+    return i - lo;
+}
+
+// Powersort boundary priority between run [s1, s1 + n1) and the run of
+// length n2 after it: the first bit where the run midpoints, scaled to
+// [0, 1), differ. Merging whenever the stack top has a higher power keeps
+// the merge tree nearly optimal for the run lengths found.
+inline int node_power(long long s1, long long n1, long long n2, long long n) {
+    long long a = 2 * s1 + n1;
+    long long b = a + n1 + n2;
+    int power = 0;
+    while (true) {
+        ++power;
+        if (a >= n) {
+            a -= n;
+            b -= n;
+        } else if (b >= n) {
+            break;
+        }
+        a <<= 1;
+        b <<= 1;
+    }
+    return power;
+}
+
+// TimSort's minimum run length: the top six bits of n, plus one if any lower
+// bit is set, so n / minRun is a power of two or slightly below one.
+inline int natural_min_run(int n) {
+    int low = 0;
+    while (n >= 64) {
+        low |= n & 1;
+        n >>= 1;
+    }
+    return n + low;
+}
+
+// Natural merge sort in the style of TimSort/powersort: ascending runs are
+// used as they are, descending runs are reversed, runs shorter than minRun are
+// extended with insertion sort, and runs are merged by the powersort stack
+// policy with galloping merges. Sorted and reversed input take O(n).
+template <class T>
+void natural_merge_sort(T *a, T *tmp, int n, int minRun) {
+    if (n <= 1) return;
+    if (minRun < 1) minRun = 1;
+
+    struct Run {
+        int start;
+        int len;
+        int power;
+    };
+    std::vector<Run> stack;
+
+    int lo = 0;
+    while (lo < n) {
+        int len = natural_run(a, lo, n);
+        if (len < minRun) {
+            len = std::min(minRun, n - lo);
+            insertion_sort_run(a, lo, lo + len);
+        }
+        int power = 0;
+        if (!stack.empty()) {
+            const Run &top = stack.back();
+            power = node_power(top.start, top.len, len, n);
+            while (stack.size() > 1 && stack.back().power > power) {
+                Run right = stack.back();
+                stack.pop_back();
+                Run &left = stack.back();
+                merge_galloping(a, left.start, right.start, right.start + right.len, tmp);
+                left.len += right.len;
+            }
+        }
+        stack.push_back(Run{lo, len, power});
+        lo += len;
+    }
+    while (stack.size() > 1) {
+        Run right = stack.back();
+        stack.pop_back();
+        Run &left = stack.back();
+        merge_galloping(a, left.start, right.start, right.start + right.len, tmp);
+        left.len += right.len;
+    }
+}
+
+template <class T>
+void natural_merge_sort(std::vector<T> &a, std::vector<T> &tmp, int minRun) {
+    int n = static_cast<int>(a.size());
+    if (static_cast<int>(tmp.size()) < n) tmp.resize(n);
+    natural_merge_sort(a.data(), tmp.data(), n, minRun);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "bottom_up_merge.h"
+#include "../common/task_pool.h"
+
+static const int PARALLEL_SORT_CUTOFF = 1 << 16;
+static const int PARALLEL_MERGE_CHUNK = 1 << 16;
+
+// Number of elements taken from a among the first k outputs of a stable merge
+// of a[0, na) and b[0, nb): equal keys come from a first.
+template <class T>
+int co_rank(int k, const T *a, int na, const T *b, int nb) {
+    int lo = std::max(0, k - nb);
+    int hi = std::min(k, na);
+    while (lo < hi) {
+        int i = lo + (hi - lo) / 2;
+        int j = k - i;
+        if (b[j - 1] >= a[i]) lo = i + 1;
+        else hi = i;
+    }
+    return lo;
+}
+
+// Splits the output into PARALLEL_MERGE_CHUNK pieces; each piece finds its two
+// input boundaries with co_rank and is merged independently.
+template <class T>
+void parallel_merge(TaskPool &pool, const T *a, int na, const T *b, int nb, T *out) {
+    int n = na + nb;
+    if (n <= PARALLEL_MERGE_CHUNK) {
+        std::merge(a, a + na, b, b + nb, out);
+        return;
+    }
+    TaskPool::Group g;
+    for (int k0 = 0; k0 < n; k0 += PARALLEL_MERGE_CHUNK) {
+        int k1 = std::min(n, k0 + PARALLEL_MERGE_CHUNK);
+        pool.spawn(g, [=] {
+            int i0 = co_rank(k0, a, na, b, nb);
+            int i1 = co_rank(k1, a, na, b, nb);
+            std::merge(a + i0, a + i1, b + (k0 - i0), b + (k1 - i1), out + k0);
+        });
+    }
+    pool.wait(g);
+}
+
+// Sorts a[l, r) and leaves the result in a when toTmp is false, in tmp
+// otherwise. Children sort into the opposite buffer, so every level merges
+// straight into its destination instead of copying back.
+template <class T>
+void parallel_merge_sort_rec(TaskPool &pool, T *a, T *tmp, int l, int r,
+                             bool toTmp, int threshold) {
+    int len = r - l;
+    if (len <= PARALLEL_SORT_CUTOFF) {
+        merge_sort_bottom_up(a + l, tmp + l, len, threshold);
+        if (toTmp) std::copy(a + l, a + r, tmp + l);
+        return;
+    }
+    int m = l + len / 2;
+    TaskPool::Group g;
+    pool.spawn(g, [=, &pool] { parallel_merge_sort_rec(pool, a, tmp, l, m, !toTmp, threshold); });
+    parallel_merge_sort_rec(pool, a, tmp, m, r, !toTmp, threshold);
+    pool.wait(g);
+
+    const T *src = toTmp ? a : tmp;
+    T *dst = toTmp ? tmp : a;
+    if (src[m - 1] <= src[m]) {
+        std::copy(src + l, src + r, dst + l);
+    } else {
+        parallel_merge(pool, src + l, m - l, src + m, r - m, dst + l);
+    }
+}
+
+template <class T>
+void parallel_merge_sort(TaskPool &pool, std::vector<T> &a, std::vector<T> &tmp, int threshold) {
+    int n = static_cast<int>(a.size());
+    if (n <= 1) return;
+    if (static_cast<int>(tmp.size()) < n) tmp.resize(n);
+    pool.run([&] { parallel_merge_sort_rec(pool, a.data(), tmp.data(), 0, n, false, threshold); });
+}
@@ -0,0 +1,406 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "bottom_up_merge.h"
+#include "../common/simd_dispatch.h"
+
+// Elements per sorting-network block and per block of the vector merge.
+static const int NETWORK_BLOCK = 16;
+
+#define NETWORK_INLINE __attribute__((always_inline)) inline
+
+// Merge without a data-dependent branch: both heads are read, the smaller one
+// is selected with a conditional move and exactly one input pointer advances.
+template <class T>
+void merge_runs_branchless(const T *src, T *dst, int l, int m, int r) {
+    const T *a = src + l;
+    const T *aEnd = src + m;
+    const T *b = src + m;
+    const T *bEnd = src + r;
+    T *out = dst + l;
+    while (a < aEnd && b < bEnd) {
+        T x = *a;
+        T y = *b;
+        bool takeB = y < x;
+        *out++ = takeB ? y : x;
+        a += !takeB;
+        b += takeB;
+    }
+    out = std::copy(a, aEnd, out);
+    std::copy(b, bEnd, out);
+}
+
+template <class T>
+void merge_sort_branchless(std::vector<T> &a, std::vector<T> &tmp, int run) {
+    int n = static_cast<int>(a.size());
+    if (n <= 1) return;
+    if (static_cast<int>(tmp.size()) < n) tmp.resize(n);
+    if (run < 1) run = 1;
+    for (int l = 0; l < n; l += run) insertion_sort_run(a.data(), l, std::min(n, l + run));
+
+    T *src = a.data();
+    T *dst = tmp.data();
+    for (long long width = run; width < n; width *= 2) {
+        for (long long l = 0; l < n; l += 2 * width) {
+            int lo = static_cast<int>(l);
+            int m = static_cast<int>(std::min<long long>(n, l + width));
+            int r = static_cast<int>(std::min<long long>(n, l + 2 * width));
+            if (m >= r || src[m - 1] <= src[m]) std::copy(src + lo, src + r, dst + lo);
+            else merge_runs_branchless(src, dst, lo, m, r);
+        }
+        std::swap(src, dst);
+    }
+    if (src != a.data()) std::copy(src, src + n, a.data());
+}
+
+// A network is a sequence of compare-exchange steps on a block held in
+// registers. Step m pairs element i with i ^ m and leaves the minimum at the
+// lower index, so every step is a permute, a min, a max and a blend. Each
+// register type supplies those operations as an "Ops" struct; the generic
+// code below is always inlined into a wrapper compiled for the right target.
+// Ops pass vectors by reference so no vector crosses a non-target ABI.
+#ifdef X86_KERNELS
+struct Avx2I32 {
+    typedef int Elem;
+    typedef __m256i Vec;
+    static const int LANES = 8;
+
+    __attribute__((target("avx2"))) static void load(Vec &v, const int *p) {
+        v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    }
+    __attribute__((target("avx2"))) static void store(int *p, const Vec &v) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+    }
+    __attribute__((target("avx2"))) static void minmax(Vec &lo, Vec &hi) {
+        __m256i mn = _mm256_min_epi32(lo, hi);
+        hi = _mm256_max_epi32(lo, hi);
+        lo = mn;
+    }
+    __attribute__((target("avx2"))) static void xor_perm(Vec &out, const Vec &in, int x) {
+        __m256i idx = _mm256_xor_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                       _mm256_set1_epi32(x));
+        out = _mm256_permutevar8x32_epi32(in, idx);
+    }
+    __attribute__((target("avx2"))) static void lane_step(Vec &v, int m, int hb) {
+        __m256i t;
+        xor_perm(t, v, m);
+        __m256i mn = _mm256_min_epi32(v, t);
+        __m256i mx = _mm256_max_epi32(v, t);
+        __m256i bit = _mm256_set1_epi32(hb);
+        __m256i upper = _mm256_cmpeq_epi32(
+            _mm256_and_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), bit), bit);
+        v = _mm256_blendv_epi8(mn, mx, upper);
+    }
+};
+
+// AVX2 has no 64-bit min/max: compare with cmpgt and blend. 64-bit lane
+// permutes are 32-bit permutes of both halves (element e goes to e ^ 2x).
+struct Avx2I64 {
+    typedef long long Elem;
+    typedef __m256i Vec;
+    static const int LANES = 4;
+
+    __attribute__((target("avx2"))) static void load(Vec &v, const long long *p) {
+        v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    }
+    __attribute__((target("avx2"))) static void store(long long *p, const Vec &v) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+    }
+    __attribute__((target("avx2"))) static void minmax(Vec &lo, Vec &hi) {
+        __m256i gt = _mm256_cmpgt_epi64(lo, hi);
+        __m256i mn = _mm256_blendv_epi8(lo, hi, gt);
+        hi = _mm256_blendv_epi8(hi, lo, gt);
+        lo = mn;
+    }
+    __attribute__((target("avx2"))) static void xor_perm(Vec &out, const Vec &in, int x) {
+        __m256i idx = _mm256_xor_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                       _mm256_set1_epi32(2 * x));
+        out = _mm256_permutevar8x32_epi32(in, idx);
+    }
+    __attribute__((target("avx2"))) static void lane_step(Vec &v, int m, int hb) {
+        __m256i mn;
+        xor_perm(mn, v, m);
+        __m256i mx = v;
+        minmax(mn, mx);
+        __m256i bit = _mm256_set1_epi32(2 * hb);
+        __m256i upper = _mm256_cmpeq_epi32(
+            _mm256_and_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), bit), bit);
+        v = _mm256_blendv_epi8(mn, mx, upper);
+    }
+};
+
+// The maskz forms with a full mask avoid GCC 12 uninitialized warnings on
+// the unmasked AVX-512 builtins.
+struct Avx512I32 {
+    typedef int Elem;
+    typedef __m512i Vec;
+    static const int LANES = 16;
+
+    __attribute__((target("avx512f"))) static void load(Vec &v, const int *p) {
+        v = _mm512_loadu_si512(p);
+    }
+    __attribute__((target("avx512f"))) static void store(int *p, const Vec &v) {
+        _mm512_storeu_si512(p, v);
+    }
+    __attribute__((target("avx512f"))) static void minmax(Vec &lo, Vec &hi) {
+        __m512i mn = _mm512_maskz_min_epi32(0xFFFF, lo, hi);
+        hi = _mm512_maskz_max_epi32(0xFFFF, lo, hi);
+        lo = mn;
+    }
+    __attribute__((target("avx512f"))) static void xor_perm(Vec &out, const Vec &in, int x) {
+        __m512i idx = _mm512_maskz_xor_epi32(
+            0xFFFF, _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+            _mm512_set1_epi32(x));
+        out = _mm512_maskz_permutexvar_epi32(0xFFFF, idx, in);
+    }
+    __attribute__((target("avx512f"))) static void lane_step(Vec &v, int m, int hb) {
+        __m512i t;
+        xor_perm(t, v, m);
+        __m512i mn = _mm512_maskz_min_epi32(0xFFFF, v, t);
+        __m512i mx = _mm512_maskz_max_epi32(0xFFFF, v, t);
+        __mmask16 upper = _mm512_test_epi32_mask(
+            _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+            _mm512_set1_epi32(hb));
+        v = _mm512_mask_blend_epi32(upper, mn, mx);
+    }
+};
+
+struct Avx512I64 {
+    typedef long long Elem;
+    typedef __m512i Vec;
+    static const int LANES = 8;
+
+    __attribute__((target("avx512f"))) static void load(Vec &v, const long long *p) {
+        v = _mm512_loadu_si512(p);
+    }
+    __attribute__((target("avx512f"))) static void store(long long *p, const Vec &v) {
+        _mm512_storeu_si512(p, v);
+    }
+    __attribute__((target("avx512f"))) static void minmax(Vec &lo, Vec &hi) {
+        __m512i mn = _mm512_maskz_min_epi64(0xFF, lo, hi);
+        hi = _mm512_maskz_max_epi64(0xFF, lo, hi);
+        lo = mn;
+    }
+    __attribute__((target("avx512f"))) static void xor_perm(Vec &out, const Vec &in, int x) {
+        __m512i idx = _mm512_maskz_xor_epi64(
+            0xFF, _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7), _mm512_set1_epi64(x));
+        out = _mm512_maskz_permutexvar_epi64(0xFF, idx, in);
+    }
+    __attribute__((target("avx512f"))) static void lane_step(Vec &v, int m, int hb) {
+        __m512i t;
+        xor_perm(t, v, m);
+        __m512i mn = _mm512_maskz_min_epi64(0xFF, v, t);
+        __m512i mx = _mm512_maskz_max_epi64(0xFF, v, t);
+        __mmask8 upper = _mm512_test_epi64_mask(_mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7),
+                                                _mm512_set1_epi64(hb));
+        v = _mm512_mask_blend_epi64(upper, mn, mx);
+    }
+};
+#endif
+
+// One compare-exchange step over REGS registers. When the highest bit of m
+// is at least LANES the partner lives in another register (r ^ m / LANES);
+// otherwise it is a lane of the same register.
+template <class Ops, int REGS>
+NETWORK_INLINE void network_step(typename Ops::Vec *v, int m) {
+    int hb = 1;
+    while (hb * 2 <= m) hb *= 2;
+    if (hb < Ops::LANES) {
+        for (int r = 0; r < REGS; ++r) Ops::lane_step(v[r], m, hb);
+        return;
+    }
+    int regXor = m / Ops::LANES;
+    int laneXor = m % Ops::LANES;
+    int regBit = hb / Ops::LANES;
+    for (int r = 0; r < REGS; ++r) {
+        if (r & regBit) continue;
+        typename Ops::Vec &partner = v[r ^ regXor];
+        if (laneXor == 0) {
+            Ops::minmax(v[r], partner);
+        } else {
+            typename Ops::Vec t;
+            Ops::xor_perm(t, partner, laneXor);
+            Ops::minmax(v[r], t);
+            Ops::xor_perm(partner, t, laneXor);
+        }
+    }
+}
+
+// Bitonic sort of REGS * LANES elements: for each block size k a flip step
+// (i ^ (k - 1)) makes the two sorted halves bitonic and the half-cleaners
+// k/4 .. 1 finish the merge.
+template <class Ops, int REGS>
+NETWORK_INLINE void network_sort(typename Ops::Vec *v) {
+    const int n = REGS * Ops::LANES;
+    for (int k = 2; k <= n; k *= 2) {
+        network_step<Ops, REGS>(v, k - 1);
+        for (int j = k / 4; j >= 1; j /= 2) network_step<Ops, REGS>(v, j);
+    }
+}
+
+// Merges two sorted blocks held in v[0, REGS) and v[REGS, 2 * REGS).
+template <class Ops, int REGS>
+NETWORK_INLINE void network_merge(typename Ops::Vec *v) {
+    const int n = REGS * Ops::LANES;
+    network_step<Ops, 2 * REGS>(v, 2 * n - 1);
+    for (int j = n / 2; j >= 1; j /= 2) network_step<Ops, 2 * REGS>(v, j);
+}
+
+// Sorts a[0, n), n <= NETWORK_BLOCK; a short block is padded with the
+// maximum value, which sorts to the tail and is never stored.
+template <class Ops>
+NETWORK_INLINE void network_sort_block(typename Ops::Elem *a, int n) {
+    typedef typename Ops::Elem T;
+    const int REGS = NETWORK_BLOCK / Ops::LANES;
+    typename Ops::Vec v[REGS];
+    if (n == NETWORK_BLOCK) {
+        for (int r = 0; r < REGS; ++r) Ops::load(v[r], a + r * Ops::LANES);
+        network_sort<Ops, REGS>(v);
+        for (int r = 0; r < REGS; ++r) Ops::store(a + r * Ops::LANES, v[r]);
+        return;
+    }
+    T buf[NETWORK_BLOCK];
+    std::copy(a, a + n, buf);
+    std::fill(buf + n, buf + NETWORK_BLOCK, std::numeric_limits<T>::max());
+    for (int r = 0; r < REGS; ++r) Ops::load(v[r], buf + r * Ops::LANES);
+    network_sort<Ops, REGS>(v);
+    for (int r = 0; r < REGS; ++r) Ops::store(buf + r * Ops::LANES, v[r]);
+    std::copy(buf, buf + n, a);
+}
+
+// Vector merge of src[l, m) and src[m, r) into dst: the upper half of the
+// last merged pair stays in registers, the next block comes from the run
+// with the smaller head, and the lower half is always final output. The
+// held block and the two tails (each shorter than a block on one side) are
+// finished with a scalar three-way merge.
+template <class Ops>
+NETWORK_INLINE void network_merge_runs(const typename Ops::Elem *src, typename Ops::Elem *dst,
+                                       int l, int m, int r) {
+    typedef typename Ops::Elem T;
+    const int B = NETWORK_BLOCK;
+    const int REGS = B / Ops::LANES;
+    if (m - l < B || r - m < B) {
+        merge_runs_branchless(src, dst, l, m, r);
+        return;
+    }
+    typename Ops::Vec v[2 * REGS];
+    int i = l;
+    int j = m;
+    int k = l;
+    for (int q = 0; q < REGS; ++q) Ops::load(v[q], src + i + q * Ops::LANES);
+    for (int q = 0; q < REGS; ++q) Ops::load(v[REGS + q], src + j + q * Ops::LANES);
+    i += B;
+    j += B;
+    network_merge<Ops, REGS>(v);
+    for (int q = 0; q < REGS; ++q) Ops::store(dst + k + q * Ops::LANES, v[q]);
+    k += B;
+    while (i + B <= m && j + B <= r) {
+        const T *next;
+        if (src[j] < src[i]) {
+            next = src + j;
+            j += B;
+        } else {
+            next = src + i;
+            i += B;
+        }
+        for (int q = 0; q < REGS; ++q) Ops::load(v[q], next + q * Ops::LANES);
+        network_merge<Ops, REGS>(v);
+        for (int q = 0; q < REGS; ++q) Ops::store(dst + k + q * Ops::LANES, v[q]);
+        k += B;
+    }
+
+    T held[B];
+    for (int q = 0; q < REGS; ++q) Ops::store(held + q * Ops::LANES, v[REGS + q]);
+    int h = 0;
+    while (k < r) {
+        T best = std::numeric_limits<T>::max();
+        int from = 0;
+        if (h < B) {
+            best = held[h];
+            from = 1;
+        }
+        if (i < m && (from == 0 || src[i] < best)) {
+            best = src[i];
+            from = 2;
+        }
+        if (j < r && (from == 0 || src[j] < best)) {
+            best = src[j];
+            from = 3;
+        }
+        dst[k++] = best;
+        if (from == 1) ++h;
+        else if (from == 2) ++i;
+        else ++j;
+    }
+}
+
+// Bottom-up merge sort whose runs are NETWORK_BLOCK elements sorted by the
+// network and whose passes use the vector merge, ping-ponging between a and
+// tmp as merge_sort_bottom_up does.
+template <class Ops>
+NETWORK_INLINE void network_merge_sort(typename Ops::Elem *a, typename Ops::Elem *tmp, int n) {
+    typedef typename Ops::Elem T;
+    for (int l = 0; l < n; l += NETWORK_BLOCK) {
+        network_sort_block<Ops>(a + l, std::min(NETWORK_BLOCK, n - l));
+    }
+    T *src = a;
+    T *dst = tmp;
+    for (long long width = NETWORK_BLOCK; width < n; width *= 2) {
+        for (long long l = 0; l < n; l += 2 * width) {
+            int lo = static_cast<int>(l);
+            int m = static_cast<int>(std::min<long long>(n, l + width));
+            int r = static_cast<int>(std::min<long long>(n, l + 2 * width));
+            if (m >= r || src[m - 1] <= src[m]) std::copy(src + lo, src + r, dst + lo);
+            else network_merge_runs<Ops>(src, dst, lo, m, r);
+        }
+        std::swap(src, dst);
+    }
+    if (src != a) std::copy(src, src + n, a);
+}
+
+#ifdef X86_KERNELS
+__attribute__((target("avx2")))
+inline void network_merge_sort_avx2(int *a, int *tmp, int n) {
+    network_merge_sort<Avx2I32>(a, tmp, n);
+}
+
+__attribute__((target("avx2")))
+inline void network_merge_sort_avx2(long long *a, long long *tmp, int n) {
+    network_merge_sort<Avx2I64>(a, tmp, n);
+}
+
+__attribute__((target("avx512f")))
+inline void network_merge_sort_avx512(int *a, int *tmp, int n) {
+    network_merge_sort<Avx512I32>(a, tmp, n);
+}
+
+__attribute__((target("avx512f")))
+inline void network_merge_sort_avx512(long long *a, long long *tmp, int n) {
+    network_merge_sort<Avx512I64>(a, tmp, n);
+}
+#endif
+
+// T is int or long long; the kernel must be supported (see detect_kernel).
+// A scalar network loses to insertion sort plus the branchless merge, so
+// that is the portable fallback.
+template <class T>
+void network_merge_sort(KernelKind kernel, std::vector<T> &a, std::vector<T> &tmp) {
+    int n = static_cast<int>(a.size());
+    if (n <= 1) return;
+    if (static_cast<int>(tmp.size()) < n) tmp.resize(n);
+#ifdef X86_KERNELS
+    if (kernel == KernelKind::Avx512) {
+        network_merge_sort_avx512(a.data(), tmp.data(), n);
+        return;
+    }
+    if (kernel == KernelKind::Avx2) {
+        network_merge_sort_avx2(a.data(), tmp.data(), n);
+        return;
+    }
+#endif
+    (void)kernel;
+    merge_sort_branchless(a, tmp, NETWORK_BLOCK);
+}
@@ -2,10 +2,23 @@
 #include <vector>
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "integer_sort.h"
+#include "block_partition.h"
+#include "pdq_sort.h"
+#include "parallel_introsort.h"
+#include "samplesort.h"
+#include "../common/fast_io.h"
+#include "../common/cutoff_profile.h"
 
 static const int INSERTION_THRESHOLD = 16;
 
-static std::uint64_t rng_state = 88172645463393265ull;
+// Per thread, so parallel introsort tasks draw pivots without a data race.
+static thread_local std::uint64_t rng_state = 88172645463393265ull;
 
 inline std::uint32_t next_rand() {
     rng_state ^= rng_state << 7;
@@ -13,9 +26,10 @@ inline std::uint32_t next_rand() {
     return static_cast<std::uint32_t>(rng_state);
 }
 
-void insertion_sort_segment(std::vector<long long> &a, int left, int right) {
+template <class T>
+void insertion_sort_segment(std::vector<T> &a, int left, int right) {
     for (int i = left + 1; i < right; ++i) {
-        long long x = a[i];
+        T x = a[i];
         int j = i - 1;
         while (j >= left && a[j] > x) {
             a[j + 1] = a[j];
@@ -25,38 +39,27 @@ void insertion_sort_segment(std::vector<long long> &a, int left, int right) {
     }
 }
 
-void heap_sort_segment(std::vector<long long> &a, int left, int right) {
+template <class T>
+void heap_sort_segment(std::vector<T> &a, int left, int right) {
     std::make_heap(a.begin() + left, a.begin() + right);
     std::sort_heap(a.begin() + left, a.begin() + right);
 }
 
-int partition_random(std::vector<long long> &a, int left, int right) {
+// Random pivot, then the branchless block partition.
+template <class T>
+int partition_random(std::vector<T> &a, int left, int right) {
     int len = right - left;
     int pivot_index = left + static_cast<int>(next_rand() % static_cast<std::uint32_t>(len));
-    long long pivot = a[pivot_index];
-
-    int i = left;
-    int j = right - 1;
-    while (true) {
-        while (a[i] < pivot) {
-            ++i;
-        }
-        while (a[j] > pivot) {
-            --j;
-        }
-        if (i >= j) {
-            return j;
-        }
-        std::swap(a[i], a[j]);
-        ++i;
-        --j;
-    }
+    return partition_block(a.data(), left, right, pivot_index);
 }
 
-void introsort_rec(std::vector<long long> &a, int left, int right, int depth_limit) {
+// Segments shorter than cutoff go to insertion sort; cutoff is
+// INSERTION_THRESHOLD unless the cutoff profile has a measured value.
+template <class T>
+void introsort_rec(std::vector<T> &a, int left, int right, int depth_limit, int cutoff) {
     while (right - left > 1) {
         int len = right - left;
-        if (len < INSERTION_THRESHOLD) {
+        if (len < cutoff) {
             insertion_sort_segment(a, left, right);
             return;
         }
@@ -73,32 +76,21 @@ void introsort_rec(std::vector<long long> &a, int left, int right, int depth_lim
 
         if (left_len < right_len) {
             if (left < p + 1) {
-                introsort_rec(a, left, p + 1, depth_limit);
+                introsort_rec(a, left, p + 1, depth_limit, cutoff);
             }
             left = p + 1;
         } else {
             if (p + 1 < right) {
-                introsort_rec(a, p + 1, right, depth_limit);
+                introsort_rec(a, p + 1, right, depth_limit, cutoff);
             }
             right = p + 1;
         }
     }
 }
 
-int main() {
-    std::ios::sync_with_stdio(false);
-    std::cin.tie(nullptr);
-
-    int n;
-    if (!(std::cin >> n)) {
-        return 0;
-    }
-
-    std::vector<long long> a(n);
-    for (int i = 0; i < n; ++i) {
-        std::cin >> a[i];
-    }
-
+template <class T>
+void introsort(std::vector<T> &a, int cutoff) {
+    int n = static_cast<int>(a.size());
     if (n > 1) {
         int depth_limit = 0;
         int m = n;
@@ -107,14 +99,115 @@ int main() {
             ++depth_limit;
         }
         depth_limit *= 2;
-        introsort_rec(a, 0, n, depth_limit);
+        introsort_rec(a, 0, n, depth_limit, cutoff);
+    }
+}
+
+// With autoEngine the choice is left to choose_engine, otherwise engine is
+// the one given by --engine. Counting is only honoured for ranges below n
+// and otherwise falls back to radix, so a forced run cannot allocate a table
+// the size of the key space.
+template <class T>
+void adaptive_sort(std::vector<T> &a, bool autoEngine, SortEngine engine, int threads,
+                   const CutoffProfile &profile) {
+    int n = static_cast<int>(a.size());
+    InputSample sample = sample_input(a.data(), n);
+    SortEngine e = autoEngine ? choose_engine(sample, n) : engine;
+    auto introsort_cutoff = [&a, &profile, n]() {
+        InputShape shape = classify_shape(a.data(), n);
+        return profile.get(cutoff_key("introsort", type_name<T>(), shape), INSERTION_THRESHOLD);
+    };
+
+    if (e == SortEngine::Parallel || e == SortEngine::Samplesort) {
+        int cutoff = introsort_cutoff();
+        auto serial = [&a, cutoff](int left, int right, int depth_limit) {
+            introsort_rec(a, left, right, depth_limit, cutoff);
+        };
+        TaskPool pool(threads);
+        if (e == SortEngine::Parallel) {
+            parallel_introsort(pool, a, serial);
+        } else {
+            samplesort(pool, a, serial);
+        }
+        return;
+    }
+
+    std::vector<T> tmp;
+    run_engine(e, sample, a, tmp, [&a, &introsort_cutoff]() { introsort(a, introsort_cutoff()); });
+}
+
+int main(int argc, char **argv) {
+    const char *inputPath = nullptr;
+    std::string profilePath = default_profile_path();
+    bool calibrate = false;
+    bool autoEngine = true;
+    SortEngine engine = SortEngine::Intro;
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i += 2) {
+        if (i + 1 == argc) {
+            std::cerr << "Missing value for " << argv[i] << "\n";
+            return 1;
+        }
+        if (std::strcmp(argv[i], "--input") == 0) {
+            inputPath = argv[i + 1];
+        } else if (std::strcmp(argv[i], "--profile") == 0) {
+            profilePath = argv[i + 1];
+        } else if (std::strcmp(argv[i], "--calibrate") == 0) {
+            calibrate = std::atoi(argv[i + 1]) != 0;
+        } else if (std::strcmp(argv[i], "--engine") == 0) {
+            autoEngine = std::strcmp(argv[i + 1], "auto") == 0;
+            if (!autoEngine && !parse_engine(argv[i + 1], engine)) {
+                std::cerr << "Unknown engine: " << argv[i + 1] << "\n";
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--threads") == 0) {
+            threads = std::atoi(argv[i + 1]);
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            return 1;
+        }
     }
 
+    CutoffProfile profile;
+    profile.load(profilePath);
+    if (calibrate) {
+        auto sortWith = [](auto &a, int cutoff) {
+            introsort(a, cutoff);
+        };
+        calibrate_cutoffs<int>(profile, "introsort", sortWith);
+        calibrate_cutoffs<long long>(profile, "introsort", sortWith);
+        if (!profile.save(profilePath)) {
+            std::cerr << "Cannot write " << profilePath << "\n";
+            return 1;
+        }
+        std::cerr << "Cutoffs saved to " << profilePath << "\n";
+    }
+
+    int fd = open_input(inputPath);
+    if (fd < 0) {
+        std::cerr << "Cannot open " << inputPath << "\n";
+        return 1;
+    }
+    FastInput in(fd);
+    FastOutput out;
+
+    int n;
+    if (!in.next(n)) {
+        return 0;
+    }
+
+    std::vector<long long> a(n);
+    for (int i = 0; i < n; ++i) {
+        in.next(a[i]);
+    }
+
+    adaptive_sort(a, autoEngine, engine, threads, profile);
+
     for (int i = 0; i < n; ++i) {
         if (i) {
-            std::cout << ' ';
+            out.put(' ');
         }
-        std::cout << a[i];
+        out.put(a[i]);
     }
 
     return 0;
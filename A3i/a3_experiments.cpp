@@ -4,6 +4,18 @@
 #include <chrono>
 #include <fstream>
 #include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <memory>
+
+#include "integer_sort.h"
+#include "block_partition.h"
+#include "pdq_sort.h"
+#include "parallel_introsort.h"
+#include "samplesort.h"
+#include "../common/bench_harness.h"
 
 class FastRng {
 public:
@@ -81,28 +93,36 @@ int partition_quick(std::vector<int> &a, int left, int right, FastRng &rng) {
     }
 }
 
-void quick_sort_rec(std::vector<int> &a, int left, int right, FastRng &rng) {
+// Same pivot draw as partition_quick, so the two differ only in the scan.
+int partition_quick_block(std::vector<int> &a, int left, int right, FastRng &rng) {
+    return partition_block(a.data(), left, right, rng.next_int(left, right));
+}
+
+typedef int (*PartitionFn)(std::vector<int> &, int, int, FastRng &);
+
+void quick_sort_rec(std::vector<int> &a, int left, int right, FastRng &rng,
+                    PartitionFn partition = partition_quick) {
     while (right - left > 1) {
-        int p = partition_quick(a, left, right, rng);
+        int p = partition(a, left, right, rng);
         int left_len = p + 1 - left;
         int right_len = right - (p + 1);
         if (left_len < right_len) {
             if (left < p + 1) {
-                quick_sort_rec(a, left, p + 1, rng);
+                quick_sort_rec(a, left, p + 1, rng, partition);
             }
             left = p + 1;
         } else {
             if (p + 1 < right) {
-                quick_sort_rec(a, p + 1, right, rng);
+                quick_sort_rec(a, p + 1, right, rng, partition);
             }
             right = p + 1;
         }
     }
 }
 
-void quick_sort(std::vector<int> &a, FastRng &rng) {
+void quick_sort(std::vector<int> &a, FastRng &rng, PartitionFn partition = partition_quick) {
     if (!a.empty()) {
-        quick_sort_rec(a, 0, static_cast<int>(a.size()), rng);
+        quick_sort_rec(a, 0, static_cast<int>(a.size()), rng, partition);
     }
 }
 
@@ -123,7 +143,8 @@ void heap_sort_segment(std::vector<int> &a, int left, int right) {
     std::sort_heap(a.begin() + left, a.begin() + right);
 }
 
-void introsort_rec(std::vector<int> &a, int left, int right, int depth_limit, FastRng &rng) {
+void introsort_rec(std::vector<int> &a, int left, int right, int depth_limit, FastRng &rng,
+                   PartitionFn partition = partition_quick) {
     while (right - left > 1) {
         int len = right - left;
         if (len < INSERTION_THRESHOLD) {
@@ -136,25 +157,25 @@ void introsort_rec(std::vector<int> &a, int left, int right, int depth_limit, Fa
         }
         --depth_limit;
 
-        int p = partition_quick(a, left, right, rng);
+        int p = partition(a, left, right, rng);
         int left_len = p + 1 - left;
         int right_len = right - (p + 1);
 
         if (left_len < right_len) {
             if (left < p + 1) {
-                introsort_rec(a, left, p + 1, depth_limit, rng);
+                introsort_rec(a, left, p + 1, depth_limit, rng, partition);
             }
             left = p + 1;
         } else {
             if (p + 1 < right) {
-                introsort_rec(a, p + 1, right, depth_limit, rng);
+                introsort_rec(a, p + 1, right, depth_limit, rng, partition);
             }
             right = p + 1;
         }
     }
 }
 
-void introsort(std::vector<int> &a, FastRng &rng) {
+void introsort(std::vector<int> &a, FastRng &rng, PartitionFn partition = partition_quick) {
     int n = static_cast<int>(a.size());
     if (n <= 1) return;
 
@@ -166,48 +187,142 @@ void introsort(std::vector<int> &a, FastRng &rng) {
     }
     depth_limit *= 2;
 
-    introsort_rec(a, 0, n, depth_limit, rng);
+    introsort_rec(a, 0, n, depth_limit, rng, partition);
 }
 
+// Runs registered cases on generated inputs through the benchmark harness.
 class SortTester {
 public:
-    explicit SortTester(const ArrayGenerator &gen) : gen_(gen) {}
+    SortTester(const ArrayGenerator &gen, const BenchOptions &opt, PerfCounters *counters)
+        : gen_(gen), opt_(opt), counters_(counters) {}
+
+    BenchResult measure(BenchCase &c, ArrayGenerator::Type type, int n) {
+        gen_.fill(base_, n, type);
+        c.load(base_);
+        BenchResult r = run_benchmark(c, opt_, counters_);
+        if (!c.sorted()) std::cerr << c.algorithm << " produced unsorted output\n";
+        return r;
+    }
 
-    long long measure_quick(ArrayGenerator::Type type, int n, int repeats) {
-        std::vector<int> base;
-        gen_.fill(base, n, type);
-        std::vector<int> a(n);
-        long long total = 0;
-        for (int rep = 0; rep < repeats; ++rep) {
-            std::copy(base.begin(), base.end(), a.begin());
-            FastRng rng(123456789u + static_cast<std::uint64_t>(rep));
-            auto start = std::chrono::high_resolution_clock::now();
+private:
+    const ArrayGenerator &gen_;
+    BenchOptions opt_;
+    PerfCounters *counters_;
+    std::vector<int> base_;
+};
+
+// Every algorithm of the a3_results sweep. Each run draws pivots from a
+// fresh FastRng seed, as the per-repeat seeds did before. The *_block cases
+// reuse their counterpart's seeds, so the branch_misses column compares the
+// two partitions on identical pivot sequences.
+std::vector<BenchCase> register_sort_cases() {
+    std::vector<BenchCase> cases;
+    cases.push_back(sort_case<int>("quick", 0,
+        [seed = 123456789ull](std::vector<int> &a, std::vector<int> &) mutable {
+            FastRng rng(seed++);
             quick_sort(a, rng);
-            auto end = std::chrono::high_resolution_clock::now();
-            total += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
-        }
-        return total / repeats;
+        }));
+    cases.push_back(sort_case<int>("intro", INSERTION_THRESHOLD,
+        [seed = 987654321ull](std::vector<int> &a, std::vector<int> &) mutable {
+            FastRng rng(seed++);
+            introsort(a, rng);
+        }));
+    cases.push_back(sort_case<int>("quick_block", PARTITION_BLOCK,
+        [seed = 123456789ull](std::vector<int> &a, std::vector<int> &) mutable {
+            FastRng rng(seed++);
+            quick_sort(a, rng, partition_quick_block);
+        }));
+    cases.push_back(sort_case<int>("intro_block", PARTITION_BLOCK,
+        [seed = 987654321ull](std::vector<int> &a, std::vector<int> &) mutable {
+            FastRng rng(seed++);
+            introsort(a, rng, partition_quick_block);
+        }));
+    cases.push_back(sort_case<int>("pdq", PDQ_INSERTION_THRESHOLD,
+        [](std::vector<int> &a, std::vector<int> &) { pdq_sort(a.data(), static_cast<int>(a.size())); }));
+    auto pool = std::make_shared<TaskPool>(static_cast<int>(std::thread::hardware_concurrency()));
+    cases.push_back(sort_case<int>("samplesort", SAMPLESORT_MAX_LOG_BUCKETS,
+        [pool](std::vector<int> &a, std::vector<int> &) {
+            samplesort(*pool, a, [&a](int left, int right, int depth_limit) {
+                FastRng rng(0x9e3779b97f4a7c15ull ^ static_cast<std::uint64_t>(left));
+                introsort_rec(a, left, right, depth_limit, rng, partition_quick_block);
+            });
+        }));
+    cases.push_back(sort_case<int>("radix", RADIX_BITS,
+        [](std::vector<int> &a, std::vector<int> &tmp) { radix_sort_lsd(a, tmp); }));
+    cases.push_back(sort_case<int>("adaptive", 0,
+        [seed = 555555555ull](std::vector<int> &a, std::vector<int> &tmp) mutable {
+            int n = static_cast<int>(a.size());
+            InputSample sample = sample_input(a.data(), n);
+            run_engine(choose_engine(sample, n), sample, a, tmp, [&a, &seed]() {
+                FastRng rng(seed++);
+                introsort(a, rng);
+            });
+        }));
+    return cases;
+}
+
+// Engines of the parallel sweep. Their leaves run the block-partition
+// introsort; each draws pivots from its own FastRng seeded by the range start.
+enum class ParallelEngine { Introsort, Samplesort };
+
+const char *parallel_engine_name(ParallelEngine e) {
+    return e == ParallelEngine::Samplesort ? "samplesort" : "introsort";
+}
+
+long long measure_parallel(std::vector<int> &a, ParallelEngine engine, std::uint64_t seed,
+                           int threads, int repeats) {
+    TaskPool pool(threads);
+    auto serial = [&a](int left, int right, int depth_limit) {
+        FastRng rng(0x9e3779b97f4a7c15ull ^ static_cast<std::uint64_t>(left));
+        introsort_rec(a, left, right, depth_limit, rng, partition_quick_block);
+    };
+    long long total = 0;
+    for (int rep = 0; rep < repeats; ++rep) {
+        FastRng gen(seed);
+        for (int &x : a) x = static_cast<int>(gen.next_u32());
+        auto start = std::chrono::steady_clock::now();
+        if (engine == ParallelEngine::Samplesort) samplesort(pool, a, serial);
+        else parallel_introsort(pool, a, serial);
+        auto end = std::chrono::steady_clock::now();
+        total += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    }
+    if (!std::is_sorted(a.begin(), a.end())) {
+        std::cerr << parallel_engine_name(engine) << " produced unsorted output\n";
+    }
+    return total / repeats;
+}
+
+// Thread-count sweep over random ints from 10^5 up to maxN elements for each
+// parallel engine; its threads=1 row is the baseline for speedup. The input
+// is regenerated before every run instead of copied, so 10^9 elements
+// (--parallel-max-n 1000000000) need 4 GB rather than 8.
+void run_parallel_sweep(int maxN, int repeats) {
+    std::ofstream out("../a3_parallel.csv");
+    if (!out) {
+        std::cerr << "Cannot open ../a3_parallel.csv for writing\n";
+        return;
     }
+    out << "n,algorithm,threads,time_us,speedup\n";
+
+    int hw = static_cast<int>(std::thread::hardware_concurrency());
+    std::vector<int> threadCounts;
+    for (int t = 1; t < hw; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(std::max(1, hw));
 
-    long long measure_intro(ArrayGenerator::Type type, int n, int repeats) {
-        std::vector<int> base;
-        gen_.fill(base, n, type);
+    const ParallelEngine engines[2] = {ParallelEngine::Introsort, ParallelEngine::Samplesort};
+    for (long long n = 100000; n <= maxN; n *= 10) {
         std::vector<int> a(n);
-        long long total = 0;
-        for (int rep = 0; rep < repeats; ++rep) {
-            std::copy(base.begin(), base.end(), a.begin());
-            FastRng rng(987654321u + static_cast<std::uint64_t>(rep));
-            auto start = std::chrono::high_resolution_clock::now();
-            introsort(a, rng);
-            auto end = std::chrono::high_resolution_clock::now();
-            total += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        for (ParallelEngine engine : engines) {
+            long long serial = 0;
+            for (int t : threadCounts) {
+                long long us = measure_parallel(a, engine, 123456789ull + n, t, repeats);
+                if (t == 1) serial = us;
+                out << n << ',' << parallel_engine_name(engine) << ',' << t << ',' << us << ','
+                    << (us > 0 ? static_cast<double>(serial) / us : 0.0) << '\n';
+            }
         }
-        return total / repeats;
     }
-
-private:
-    const ArrayGenerator &gen_;
-};
+}
 
 const char *array_type_name(ArrayGenerator::Type t) {
     if (t == ArrayGenerator::Type::Random) return "random";
@@ -215,43 +330,61 @@ const char *array_type_name(ArrayGenerator::Type t) {
     return "almost";
 }
 
-int main() {
+int main(int argc, char **argv) {
+    bool json = false;
+    int pinCpu = -1;
+    bool useCounters = true;
+    int parallelMaxN = 10000000;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--format") == 0) json = std::strcmp(argv[i + 1], "json") == 0;
+        else if (std::strcmp(argv[i], "--pin-cpu") == 0) pinCpu = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--counters") == 0) useCounters = std::atoi(argv[i + 1]) != 0;
+        else if (std::strcmp(argv[i], "--parallel-max-n") == 0) parallelMaxN = std::atoi(argv[i + 1]);
+    }
+
     const int MAX_N = 100000;
     const int MIN_N = 500;
     const int STEP_N = 1000;
     const int MAX_VALUE = 6000;
-    const int REPEATS = 5;
+
+    if (pinCpu >= 0 && !pin_to_cpu(pinCpu)) {
+        std::cerr << "Cannot pin to CPU " << pinCpu << "\n";
+    }
+    PerfCounters perf;
+    if (useCounters && !perf.available()) {
+        std::cerr << "perf_event_open unavailable; counter columns are -1\n";
+    }
+    BenchOptions opt;
 
     ArrayGenerator generator(MAX_N, MAX_VALUE);
-    SortTester tester(generator);
+    SortTester tester(generator, opt, useCounters ? &perf : nullptr);
 
-    std::ofstream out("../a3_results.csv");
-    if (!out) {
-        std::cerr << "Cannot open a3_results.csv for writing\n";
+    std::string resultsPath = json ? "../a3_results.json" : "../a3_results.csv";
+    BenchWriter out(resultsPath, json);
+    if (!out.ok()) {
+        std::cerr << "Cannot open " << resultsPath << " for writing\n";
         return 1;
     }
 
-    out << "n,array_type,algorithm,time_us\n";
-
     ArrayGenerator::Type types[3] = {
         ArrayGenerator::Type::Random,
         ArrayGenerator::Type::Reversed,
         ArrayGenerator::Type::AlmostSorted
     };
 
+    std::vector<BenchCase> cases = register_sort_cases();
+
     for (int n = MIN_N; n <= MAX_N; n += STEP_N) {
         for (int ti = 0; ti < 3; ++ti) {
-            ArrayGenerator::Type t = types[ti];
-            const char *name = array_type_name(t);
-
-            long long tq = tester.measure_quick(t, n, REPEATS);
-            out << n << ',' << name << ",quick," << tq << '\n';
-
-            long long ti_intro = tester.measure_intro(t, n, REPEATS);
-            out << n << ',' << name << ",intro," << ti_intro << '\n';
+            const char *name = array_type_name(types[ti]);
+            for (BenchCase &c : cases) {
+                out.row(n, name, c, tester.measure(c, types[ti], n));
+            }
         }
     }
 
-    std::cerr << "Done. Results written to a3_results.csv\n";
+    run_parallel_sweep(parallelMaxN, 3);
+
+    std::cerr << "Done. Results written to " << resultsPath << " and ../a3_parallel.csv\n";
     return 0;
 }
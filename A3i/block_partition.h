@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+
+// Elements classified per block; offsets fit in one byte and one block of
+// each buffer spans a single cache line.
+static const int PARTITION_BLOCK = 64;
+
+// Swaps the first num pending pairs: misplaced element offsetsL[i] from the
+// left block with misplaced element offsetsR[i] from the right block, where
+// right offsets count back from lastR (exclusive).
+template <class T>
+inline void swap_offsets(T *firstL, T *lastR, const unsigned char *offsetsL,
+                         const unsigned char *offsetsR, int num) {
+    for (int i = 0; i < num; ++i) {
+        std::swap(firstL[offsetsL[i]], lastR[-1 - offsetsR[i]]);
+    }
+}
+
+// Block partition (BlockQuicksort) of [first, last). Each side scans a
+// whole block and records the offsets of misplaced elements with an
+// unconditional store and a flag-sized increment, so the comparisons never
+// feed a branch; the recorded pairs are then swapped in bulk. misplacedL(x)
+// and misplacedR(x) say which elements belong to the other side. Returns the
+// boundary: [first, result) holds no left-misplaced element and
+// [result, last) no right-misplaced one.
+template <class T, class MisplacedL, class MisplacedR>
+T *block_partition_range(T *first, T *last, MisplacedL misplacedL, MisplacedR misplacedR) {
+    unsigned char offsetsL[PARTITION_BLOCK];
+    unsigned char offsetsR[PARTITION_BLOCK];
+    int startL = 0, startR = 0, numL = 0, numR = 0;
+
+    while (last - first > 2 * PARTITION_BLOCK) {
+        if (numL == 0) {
+            startL = 0;
+            for (int i = 0; i < PARTITION_BLOCK; ++i) {
+                offsetsL[numL] = static_cast<unsigned char>(i);
+                numL += misplacedL(first[i]);
+            }
+        }
+        if (numR == 0) {
+            startR = 0;
+            for (int i = 0; i < PARTITION_BLOCK; ++i) {
+                offsetsR[numR] = static_cast<unsigned char>(i);
+                numR += misplacedR(last[-1 - i]);
+            }
+        }
+        int num = std::min(numL, numR);
+        swap_offsets(first, last, offsetsL + startL, offsetsR + startR, num);
+        numL -= num;
+        numR -= num;
+        startL += num;
+        startR += num;
+        if (numL == 0) first += PARTITION_BLOCK;
+        if (numR == 0) last -= PARTITION_BLOCK;
+    }
+
+    // Tail: at most two blocks remain, one of them possibly half consumed.
+    // Split the unscanned part between the sides, classify it the same way,
+    // then move whatever stays misplaced to the far end of the other side.
+    int pending = (numL || numR) ? PARTITION_BLOCK : 0;
+    int unknown = static_cast<int>(last - first) - pending;
+    int sizeL, sizeR;
+    if (numR) {
+        sizeL = unknown;
+        sizeR = PARTITION_BLOCK;
+    } else if (numL) {
+        sizeL = PARTITION_BLOCK;
+        sizeR = unknown;
+    } else {
+        sizeL = unknown / 2;
+        sizeR = unknown - sizeL;
+    }
+    if (unknown && !numL) {
+        startL = 0;
+        for (int i = 0; i < sizeL; ++i) {
+            offsetsL[numL] = static_cast<unsigned char>(i);
+            numL += misplacedL(first[i]);
+        }
+    }
+    if (unknown && !numR) {
+        startR = 0;
+        for (int i = 0; i < sizeR; ++i) {
+            offsetsR[numR] = static_cast<unsigned char>(i);
+            numR += misplacedR(last[-1 - i]);
+        }
+    }
+    int num = std::min(numL, numR);
+    swap_offsets(first, last, offsetsL + startL, offsetsR + startR, num);
+    numL -= num;
+    numR -= num;
+    startL += num;
+    startR += num;
+    if (numL == 0) first += sizeL;
+    if (numR == 0) last -= sizeR;
+
+    if (numL) {
+        while (numL--) std::swap(first[offsetsL[startL + numL]], *--last);
+        first = last;
+    }
+    if (numR) {
+        while (numR--) std::swap(last[-1 - offsetsR[startR + numR]], *first++);
+        last = first;
+    }
+    return first;
+}
+
+// Partitions [left, right) around a[pivotIndex]. The predicates match
+// partition_random's Hoare scans (left stops on >= pivot, right on <= pivot),
+// so equal keys are split between both sides.
+//
+// Returns p with [left, p] <= pivot <= [p + 1, right) and both sides
+// non-empty, the contract introsort_rec expects from a Hoare partition.
+template <class T>
+int partition_block(T *a, int left, int right, int pivotIndex) {
+    std::swap(a[left], a[pivotIndex]);
+    const T pivot = a[left];
+    T *boundary = block_partition_range(a + left + 1, a + right,
+        [pivot](const T &x) { return !(x < pivot); },
+        [pivot](const T &x) { return !(pivot < x); });
+
+    int p = static_cast<int>(boundary - a) - 1;
+    std::swap(a[left], a[p]);
+    // The pivot now sits at p; keep it in the left part unless that would
+    // leave the right part empty.
+    return p == right - 1 ? p - 1 : p;
+}
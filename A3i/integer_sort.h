@@ -0,0 +1,157 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+
+#include "pdq_sort.h"
+
+// Below this many elements pdqsort wins over a histogram pass.
+static const int RADIX_MIN_N = 384;
+
+static const int RADIX_BITS = 8;
+static const int RADIX_BUCKETS = 1 << RADIX_BITS;
+
+// Sorts integer keys in [lo, hi] by counting occurrences and rewriting the
+// array; only keys are sorted, so no stable scatter is needed.
+template <class T>
+void counting_sort(T *a, int n, T lo, T hi) {
+    std::vector<int> count(static_cast<std::size_t>(hi - lo) + 1, 0);
+    for (int i = 0; i < n; ++i) ++count[static_cast<std::size_t>(a[i] - lo)];
+    T *out = a;
+    for (std::size_t v = 0; v < count.size(); ++v) {
+        out = std::fill_n(out, count[v], static_cast<T>(lo + static_cast<T>(v)));
+    }
+}
+
+// LSD radix sort over 8-bit digits, ping-ponging between a and tmp. Keys are
+// mapped to unsigned with the sign bit flipped so negatives order first. All
+// digit histograms come from one pass, and a digit shared by every element
+// (one bucket holding n) is skipped, so narrow value ranges need few passes.
+template <class T>
+void radix_sort_lsd(std::vector<T> &a, std::vector<T> &tmp) {
+    typedef typename std::make_unsigned<T>::type U;
+    const int digits = static_cast<int>(sizeof(T)) * 8 / RADIX_BITS;
+    const U signBit = static_cast<U>(U(1) << (sizeof(T) * 8 - 1));
+    int n = static_cast<int>(a.size());
+    if (n <= 1) return;
+    if (static_cast<int>(tmp.size()) < n) tmp.resize(n);
+
+    std::vector<int> hist(static_cast<std::size_t>(digits) * RADIX_BUCKETS, 0);
+    for (int i = 0; i < n; ++i) {
+        U key = static_cast<U>(a[i]) ^ signBit;
+        for (int d = 0; d < digits; ++d) {
+            ++hist[d * RADIX_BUCKETS + ((key >> (d * RADIX_BITS)) & (RADIX_BUCKETS - 1))];
+        }
+    }
+
+    T *src = a.data();
+    T *dst = tmp.data();
+    for (int d = 0; d < digits; ++d) {
+        int *h = hist.data() + d * RADIX_BUCKETS;
+        U first = ((static_cast<U>(src[0]) ^ signBit) >> (d * RADIX_BITS)) & (RADIX_BUCKETS - 1);
+        if (h[first] == n) continue;
+
+        int offset = 0;
+        for (int b = 0; b < RADIX_BUCKETS; ++b) {
+            int c = h[b];
+            h[b] = offset;
+            offset += c;
+        }
+        for (int i = 0; i < n; ++i) {
+            U key = static_cast<U>(src[i]) ^ signBit;
+            dst[h[(key >> (d * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    if (src != a.data()) std::copy(src, src + n, a.data());
+}
+
+// Parallel and Samplesort are only ever requested explicitly; choose_engine
+// picks among the single-threaded engines.
+enum class SortEngine { Intro, Counting, Radix, Pdq, Parallel, Samplesort };
+
+// Engine names for --engine; "auto" is left to the caller.
+inline bool parse_engine(const char *s, SortEngine &e) {
+    if (std::strcmp(s, "intro") == 0) e = SortEngine::Intro;
+    else if (std::strcmp(s, "counting") == 0) e = SortEngine::Counting;
+    else if (std::strcmp(s, "radix") == 0) e = SortEngine::Radix;
+    else if (std::strcmp(s, "pdq") == 0) e = SortEngine::Pdq;
+    else if (std::strcmp(s, "parallel") == 0) e = SortEngine::Parallel;
+    else if (std::strcmp(s, "samplesort") == 0) e = SortEngine::Samplesort;
+    else return false;
+    return true;
+}
+
+// What the dispatcher learned about the input: the exact range from one
+// pass, and the descents among up to SAMPLE_PAIRS evenly spaced neighbours.
+struct InputSample {
+    long long lo = 0;
+    long long hi = 0;
+    int pairs = 0;
+    int descents = 0;
+};
+
+static const int SAMPLE_PAIRS = 1024;
+
+template <class T>
+InputSample sample_input(const T *a, int n) {
+    InputSample s;
+    if (n == 0) return s;
+    T lo = a[0];
+    T hi = a[0];
+    for (int i = 1; i < n; ++i) {
+        lo = std::min(lo, a[i]);
+        hi = std::max(hi, a[i]);
+    }
+    s.lo = lo;
+    s.hi = hi;
+    int step = std::max(1, (n - 1) / SAMPLE_PAIRS);
+    for (int i = 1; i < n; i += step) {
+        ++s.pairs;
+        s.descents += a[i] < a[i - 1];
+    }
+    return s;
+}
+
+// Counting sort beats radix sort while the range is below n: past that the
+// table of counts, not the array, sets the cost. It also keeps the table no
+// larger than the scratch buffer radix sort would allocate.
+inline bool counting_fits(const InputSample &s, int n) {
+    unsigned long long range = static_cast<unsigned long long>(s.hi) -
+                               static_cast<unsigned long long>(s.lo);
+    return range < static_cast<unsigned long long>(n);
+}
+
+// Small inputs go to pdqsort. A narrow range goes to counting sort, which is
+// linear whatever the order. A sample that is almost sorted goes to pdqsort,
+// whose partial insertion sorts finish sorted stretches in linear time;
+// everything else goes to radix sort.
+inline SortEngine choose_engine(const InputSample &s, int n) {
+    if (n < RADIX_MIN_N) return SortEngine::Pdq;
+    if (counting_fits(s, n)) return SortEngine::Counting;
+    if (s.descents * 100 <= s.pairs) return SortEngine::Pdq;
+    return SortEngine::Radix;
+}
+
+// Runs a single-threaded engine on a, with s from sample_input(a). Counting
+// sort falls back to radix sort unless counting_fits. Introsort is the
+// caller's intro(), since each caller picks its own cutoff and pivot source.
+template <class T, class IntroSort>
+void run_engine(SortEngine e, const InputSample &s, std::vector<T> &a, std::vector<T> &tmp,
+                const IntroSort &intro) {
+    int n = static_cast<int>(a.size());
+    if (e == SortEngine::Counting && !counting_fits(s, n)) e = SortEngine::Radix;
+
+    if (e == SortEngine::Counting) {
+        counting_sort(a.data(), n, static_cast<T>(s.lo), static_cast<T>(s.hi));
+    } else if (e == SortEngine::Radix) {
+        radix_sort_lsd(a, tmp);
+    } else if (e == SortEngine::Pdq) {
+        pdq_sort(a.data(), n);
+    } else {
+        intro();
+    }
+}
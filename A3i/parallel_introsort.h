@@ -0,0 +1,172 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+#include "block_partition.h"
+#include "../common/task_pool.h"
+
+// Ranges up to PARALLEL_INTRO_CUTOFF are one serial task. Ranges of at least
+// PARALLEL_PARTITION_MIN are partitioned by all workers, in chunks of
+// PARALLEL_PARTITION_CHUNK elements; in between a single worker partitions.
+static const int PARALLEL_INTRO_CUTOFF = 1 << 15;
+static const int PARALLEL_PARTITION_MIN = 1 << 20;
+static const int PARALLEL_PARTITION_CHUNK = 1 << 16;
+
+// Misplaced elements found after the chunk pass: [begin, end) ranges in
+// array order, offset[i] counting the elements in ranges before i.
+struct MisplacedRanges {
+    std::vector<int> begin;
+    std::vector<int> end;
+    std::vector<long long> offset;
+    long long total = 0;
+
+    void add(int b, int e) {
+        if (b >= e) return;
+        begin.push_back(b);
+        end.push_back(e);
+        offset.push_back(total);
+        total += e - b;
+    }
+
+    // Range holding the k-th misplaced element.
+    int find(long long k) const {
+        return static_cast<int>(std::upper_bound(offset.begin(), offset.end(), k) - offset.begin()) - 1;
+    }
+};
+
+// Partitions [left, right) so that elements with isLeft(x) come first and
+// returns the boundary. Workers claim chunks through an atomic counter and
+// block-partition each one locally. Every chunk is then [left part][right
+// part], so the elements on the wrong side of the global boundary form a few
+// ranges whose sizes match on both sides; a second pass claims equal slices
+// of them and swaps the k-th misplaced left element with the k-th misplaced
+// right element. In place, with two sweeps over the range.
+template <class T, class IsLeft>
+int parallel_partition(TaskPool &pool, T *a, int left, int right, IsLeft isLeft) {
+    int chunks = (right - left + PARALLEL_PARTITION_CHUNK - 1) / PARALLEL_PARTITION_CHUNK;
+    std::vector<int> split(chunks);
+    std::atomic<int> nextChunk(0);
+    TaskPool::Group g;
+    for (int w = 0; w < pool.size(); ++w) {
+        pool.spawn(g, [&] {
+            int c;
+            while ((c = nextChunk.fetch_add(1, std::memory_order_relaxed)) < chunks) {
+                int lo = left + c * PARALLEL_PARTITION_CHUNK;
+                int hi = std::min(right, lo + PARALLEL_PARTITION_CHUNK);
+                T *boundary = block_partition_range(a + lo, a + hi,
+                    [&isLeft](const T &x) { return !isLeft(x); }, isLeft);
+                split[c] = static_cast<int>(boundary - a);
+            }
+        });
+    }
+    pool.wait(g);
+
+    long long leftCount = 0;
+    for (int c = 0; c < chunks; ++c) leftCount += split[c] - (left + c * PARALLEL_PARTITION_CHUNK);
+    int mid = left + static_cast<int>(leftCount);
+
+    MisplacedRanges wrongL;
+    MisplacedRanges wrongR;
+    for (int c = 0; c < chunks; ++c) {
+        int lo = left + c * PARALLEL_PARTITION_CHUNK;
+        int hi = std::min(right, lo + PARALLEL_PARTITION_CHUNK);
+        wrongL.add(split[c], std::min(hi, mid));
+        wrongR.add(std::max(lo, mid), split[c]);
+    }
+
+    long long total = wrongL.total;
+    long long slices = (total + PARALLEL_PARTITION_CHUNK - 1) / PARALLEL_PARTITION_CHUNK;
+    std::atomic<long long> nextSlice(0);
+    for (int w = 0; w < pool.size(); ++w) {
+        pool.spawn(g, [&] {
+            long long s;
+            while ((s = nextSlice.fetch_add(1, std::memory_order_relaxed)) < slices) {
+                long long k = s * PARALLEL_PARTITION_CHUNK;
+                long long kEnd = std::min(total, k + PARALLEL_PARTITION_CHUNK);
+                int i = wrongL.find(k);
+                int j = wrongR.find(k);
+                int p = wrongL.begin[i] + static_cast<int>(k - wrongL.offset[i]);
+                int q = wrongR.begin[j] + static_cast<int>(k - wrongR.offset[j]);
+                for (; k < kEnd; ++k) {
+                    if (p == wrongL.end[i]) p = wrongL.begin[++i];
+                    if (q == wrongR.end[j]) q = wrongR.begin[++j];
+                    std::swap(a[p++], a[q++]);
+                }
+            }
+        });
+    }
+    pool.wait(g);
+    return mid;
+}
+
+// Partitions with every worker when the range is large enough to pay for
+// it, otherwise on the calling worker alone.
+template <class T, class IsLeft>
+int partition_range(TaskPool &pool, T *a, int left, int right, IsLeft isLeft) {
+    if (right - left >= PARALLEL_PARTITION_MIN && pool.size() > 1) {
+        return parallel_partition(pool, a, left, right, isLeft);
+    }
+    T *boundary = block_partition_range(a + left, a + right,
+        [&isLeft](const T &x) { return !isLeft(x); }, isLeft);
+    return static_cast<int>(boundary - a);
+}
+
+// Median of three evenly spaced medians of three.
+template <class T>
+T ninther_value(const T *a, int left, int right) {
+    auto median3 = [](T x, T y, T z) { return std::max(std::min(x, y), std::min(std::max(x, y), z)); };
+    int step = (right - left) / 9;
+    T m[3];
+    for (int i = 0; i < 3; ++i) {
+        int base = left + (3 * i + 1) * step;
+        m[i] = median3(a[base - step], a[base], a[base + step]);
+    }
+    return median3(m[0], m[1], m[2]);
+}
+
+// Introsort over the pool. Each partition keeps [m, right) on the current
+// worker and pushes [left, m) as a task other workers can steal; ranges of
+// at most PARALLEL_INTRO_CUTOFF go to serial(left, right, depthLimit), which
+// keeps its own heap-sort guard. A pivot equal to the range minimum leaves
+// the left side empty; its duplicates are then split off with a second
+// partition on <= pivot and are already in place.
+template <class T, class SerialSort>
+void parallel_introsort_rec(TaskPool &pool, T *a, int left, int right, int depthLimit,
+                            const SerialSort &serial) {
+    TaskPool::Group g;
+    while (right - left > 1) {
+        if (right - left <= PARALLEL_INTRO_CUTOFF) {
+            serial(left, right, depthLimit);
+            break;
+        }
+        if (depthLimit == 0) {
+            std::make_heap(a + left, a + right);
+            std::sort_heap(a + left, a + right);
+            break;
+        }
+        --depthLimit;
+
+        T pivot = ninther_value(a, left, right);
+        int m = partition_range(pool, a, left, right, [pivot](const T &x) { return x < pivot; });
+        if (m == left) {
+            left = partition_range(pool, a, left, right, [pivot](const T &x) { return !(pivot < x); });
+            continue;
+        }
+        int l = left;
+        pool.spawn(g, [=, &pool, &serial] { parallel_introsort_rec(pool, a, l, m, depthLimit, serial); });
+        left = m;
+    }
+    pool.wait(g);
+}
+
+template <class T, class SerialSort>
+void parallel_introsort(TaskPool &pool, std::vector<T> &a, const SerialSort &serial) {
+    int n = static_cast<int>(a.size());
+    if (n <= 1) return;
+    int depthLimit = 0;
+    for (int m = n; m > 1; m >>= 1) ++depthLimit;
+    depthLimit *= 2;
+    pool.run([&] { parallel_introsort_rec(pool, a.data(), 0, n, depthLimit, serial); });
+}
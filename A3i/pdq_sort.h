@@ -0,0 +1,219 @@
+#pragma once
+
+#include <algorithm>
+
+#include "block_partition.h"
+
+// Ranges shorter than this go to insertion sort; above PDQ_NINTHER the pivot
+// is Tukey's ninther instead of a median of three.
+static const int PDQ_INSERTION_THRESHOLD = 24;
+static const int PDQ_NINTHER = 128;
+
+// A partial insertion sort gives up after this many element moves.
+static const int PDQ_PARTIAL_LIMIT = 8;
+
+template <class T>
+void pdq_insertion_sort(T *a, int left, int right) {
+    for (int i = left + 1; i < right; ++i) {
+        T x = a[i];
+        int j = i - 1;
+        while (j >= left && a[j] > x) {
+            a[j + 1] = a[j];
+            --j;
+        }
+        a[j + 1] = x;
+    }
+}
+
+// Insertion sort without the lower bound check; a[left - 1] must not be
+// greater than any element of the range, which holds for every range but
+// the leftmost one.
+template <class T>
+void pdq_unguarded_insertion_sort(T *a, int left, int right) {
+    for (int i = left + 1; i < right; ++i) {
+        T x = a[i];
+        int j = i - 1;
+        while (a[j] > x) {
+            a[j + 1] = a[j];
+            --j;
+        }
+        a[j + 1] = x;
+    }
+}
+
+// Insertion sort that stops once PDQ_PARTIAL_LIMIT elements have moved;
+// true if the range ended up sorted.
+template <class T>
+bool pdq_partial_insertion_sort(T *a, int left, int right) {
+    int moved = 0;
+    for (int i = left + 1; i < right; ++i) {
+        if (!(a[i] < a[i - 1])) continue;
+        T x = a[i];
+        int j = i - 1;
+        while (j >= left && a[j] > x) {
+            a[j + 1] = a[j];
+            --j;
+        }
+        a[j + 1] = x;
+        moved += i - j - 1;
+        if (moved > PDQ_PARTIAL_LIMIT) return false;
+    }
+    return true;
+}
+
+// Orders a[i] <= a[j] <= a[k].
+template <class T>
+inline void pdq_sort3(T *a, int i, int j, int k) {
+    if (a[j] < a[i]) std::swap(a[i], a[j]);
+    if (a[k] < a[j]) std::swap(a[j], a[k]);
+    if (a[j] < a[i]) std::swap(a[i], a[j]);
+}
+
+// Partitions [left, right) around the pivot a[left] into < pivot and
+// >= pivot and returns the pivot's final index. alreadyPartitioned is set
+// when no element had to move. The pivot selection leaves an element
+// >= pivot at right - 1, which bounds the first scan.
+template <class T>
+int pdq_partition_right(T *a, int left, int right, bool &alreadyPartitioned) {
+    const T pivot = a[left];
+    int first = left;
+    int last = right;
+    while (a[++first] < pivot) {
+    }
+    if (first - 1 == left) {
+        while (first < last && !(a[--last] < pivot)) {
+        }
+    } else {
+        while (!(a[--last] < pivot)) {
+        }
+    }
+
+    alreadyPartitioned = first >= last;
+    if (!alreadyPartitioned) {
+        std::swap(a[first], a[last]);
+        ++first;
+        T *boundary = block_partition_range(a + first, a + last,
+            [pivot](const T &x) { return !(x < pivot); },
+            [pivot](const T &x) { return x < pivot; });
+        first = static_cast<int>(boundary - a);
+    }
+
+    int p = first - 1;
+    a[left] = a[p];
+    a[p] = pivot;
+    return p;
+}
+
+// Fat partition for a pivot equal to a[left - 1]: [left, result] <= pivot
+// and the rest is > pivot. Nothing in the range is below a[left - 1], so
+// the left part is a run of keys equal to the pivot and is done.
+template <class T>
+int pdq_partition_left(T *a, int left, int right) {
+    const T pivot = a[left];
+    int first = left;
+    int last = right;
+    while (pivot < a[--last]) {
+    }
+    if (last + 1 == right) {
+        while (first < last && !(pivot < a[++first])) {
+        }
+    } else {
+        while (!(pivot < a[++first])) {
+        }
+    }
+    while (first < last) {
+        std::swap(a[first], a[last]);
+        while (pivot < a[--last]) {
+        }
+        while (!(pivot < a[++first])) {
+        }
+    }
+
+    a[left] = a[last];
+    a[last] = pivot;
+    return last;
+}
+
+// Pattern-defeating quicksort (pdqsort). badAllowed counts the highly
+// unbalanced partitions still tolerated before the range goes to heap sort.
+// After one, a fixed set of elements is swapped into the pivot positions of
+// both halves, which breaks patterns such as organ pipes without an RNG.
+template <class T>
+void pdq_sort_rec(T *a, int left, int right, int badAllowed, bool leftmost) {
+    while (true) {
+        int len = right - left;
+        if (len < PDQ_INSERTION_THRESHOLD) {
+            if (leftmost) pdq_insertion_sort(a, left, right);
+            else pdq_unguarded_insertion_sort(a, left, right);
+            return;
+        }
+
+        int half = len / 2;
+        if (len > PDQ_NINTHER) {
+            pdq_sort3(a, left, left + half, right - 1);
+            pdq_sort3(a, left + 1, left + half - 1, right - 2);
+            pdq_sort3(a, left + 2, left + half + 1, right - 3);
+            pdq_sort3(a, left + half - 1, left + half, left + half + 1);
+            std::swap(a[left], a[left + half]);
+        } else {
+            pdq_sort3(a, left + half, left, right - 1);
+        }
+
+        // A pivot equal to the previous range's pivot means this range starts
+        // with a block of duplicates; split them off in one pass.
+        if (!leftmost && !(a[left - 1] < a[left])) {
+            left = pdq_partition_left(a, left, right) + 1;
+            continue;
+        }
+
+        bool alreadyPartitioned = false;
+        int p = pdq_partition_right(a, left, right, alreadyPartitioned);
+        int leftLen = p - left;
+        int rightLen = right - (p + 1);
+
+        if (leftLen < len / 8 || rightLen < len / 8) {
+            if (--badAllowed == 0) {
+                std::make_heap(a + left, a + right);
+                std::sort_heap(a + left, a + right);
+                return;
+            }
+            if (leftLen >= PDQ_INSERTION_THRESHOLD) {
+                std::swap(a[left], a[left + leftLen / 4]);
+                std::swap(a[p - 1], a[p - leftLen / 4]);
+                if (leftLen > PDQ_NINTHER) {
+                    std::swap(a[left + 1], a[left + leftLen / 4 + 1]);
+                    std::swap(a[left + 2], a[left + leftLen / 4 + 2]);
+                    std::swap(a[p - 2], a[p - leftLen / 4 - 1]);
+                    std::swap(a[p - 3], a[p - leftLen / 4 - 2]);
+                }
+            }
+            if (rightLen >= PDQ_INSERTION_THRESHOLD) {
+                std::swap(a[p + 1], a[p + 1 + rightLen / 4]);
+                std::swap(a[right - 1], a[right - rightLen / 4]);
+                if (rightLen > PDQ_NINTHER) {
+                    std::swap(a[p + 2], a[p + 2 + rightLen / 4]);
+                    std::swap(a[p + 3], a[p + 3 + rightLen / 4]);
+                    std::swap(a[right - 2], a[right - 1 - rightLen / 4]);
+                    std::swap(a[right - 3], a[right - 2 - rightLen / 4]);
+                }
+            }
+        } else if (alreadyPartitioned && pdq_partial_insertion_sort(a, left, p) &&
+                   pdq_partial_insertion_sort(a, p + 1, right)) {
+            // A balanced partition that moved nothing suggests sorted input;
+            // both halves finished with only a few moves.
+            return;
+        }
+
+        pdq_sort_rec(a, left, p, badAllowed, leftmost);
+        left = p + 1;
+        leftmost = false;
+    }
+}
+
+template <class T>
+void pdq_sort(T *a, int n) {
+    if (n <= 1) return;
+    int log2n = 0;
+    for (int m = n; m > 1; m >>= 1) ++log2n;
+    pdq_sort_rec(a, 0, n, log2n, true);
+}
@@ -0,0 +1,425 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+
+#include "../common/task_pool.h"
+
+// Ranges up to SAMPLESORT_BASE go to the serial fallback. Ranges of at least
+// SAMPLESORT_PARALLEL_MIN are distributed by all workers; smaller buckets
+// are each one serial task.
+static const int SAMPLESORT_BASE = 1 << 14;
+static const int SAMPLESORT_PARALLEL_MIN = 1 << 20;
+
+// At most 2^7 splitter intervals per level (2^8 buckets with the equality
+// buckets), moved in blocks of 2 KiB.
+static const int SAMPLESORT_MAX_LOG_BUCKETS = 7;
+static const int SAMPLESORT_BLOCK_BYTES = 2048;
+
+// A level whose sample was unlucky still shrinks every bucket, but not by
+// much; after this many levels the serial fallback takes over.
+static const int SAMPLESORT_MAX_LEVELS = 8;
+
+// Elements classified together so the tree descents of a batch overlap.
+static const int SAMPLESORT_BATCH = 8;
+
+// Splitters s_0 < ... < s_{k-2} stored as an implicit search tree (the root
+// at 1, children of i at 2i and 2i + 1). A descent is log2(k) steps of
+// i = 2i + (tree[i] < x) with no branch on the data, and ends at the number of
+// splitters below x. Keys equal to a splitter get their own bucket, so
+// bucket 2b holds s_{b-1} < x < s_b and bucket 2b + 1 holds x == s_b; the
+// last bucket holds everything above the largest splitter.
+template <class T>
+class BucketClassifier {
+public:
+    // splitters is sorted, unique and has fewer than 2^logBuckets entries.
+    BucketClassifier(const std::vector<T> &splitters, int logBuckets)
+        : log_(logBuckets), k_(1 << logBuckets), tree_(k_), sorted_(k_) {
+        int m = static_cast<int>(splitters.size());
+        for (int i = 0; i < k_ - 1; ++i) sorted_[i] = splitters[std::min(i, m - 1)];
+        sorted_[k_ - 1] = sorted_[k_ - 2];
+        build(1, 0, k_ - 1);
+    }
+
+    int buckets() const { return 2 * k_; }
+
+    bool is_equality(int bucket) const { return (bucket & 1) && bucket != 2 * k_ - 1; }
+
+    int classify(const T &x) const {
+        int i = 1;
+        for (int l = 0; l < log_; ++l) i = 2 * i + (tree_[i] < x);
+        int b = i - k_;
+        return 2 * b + !(x < sorted_[b]);
+    }
+
+    void classify_batch(const T *x, int *bucket) const {
+        int idx[SAMPLESORT_BATCH];
+        for (int e = 0; e < SAMPLESORT_BATCH; ++e) idx[e] = 1;
+        for (int l = 0; l < log_; ++l) {
+            for (int e = 0; e < SAMPLESORT_BATCH; ++e) idx[e] = 2 * idx[e] + (tree_[idx[e]] < x[e]);
+        }
+        for (int e = 0; e < SAMPLESORT_BATCH; ++e) {
+            int b = idx[e] - k_;
+            bucket[e] = 2 * b + !(x[e] < sorted_[b]);
+        }
+    }
+
+private:
+    void build(int node, int lo, int hi) {
+        if (node >= k_) return;
+        int mid = (lo + hi) / 2;
+        tree_[node] = sorted_[mid];
+        build(2 * node, lo, mid);
+        build(2 * node + 1, mid + 1, hi);
+    }
+
+    int log_;
+    int k_;
+    std::vector<T> tree_;
+    std::vector<T> sorted_;
+};
+
+// Runs fn(i) for every i in [0, count). With a pool, `workers` tasks claim
+// indices from an atomic counter; without one the loop runs inline.
+template <class F>
+void samplesort_for_each(TaskPool *pool, int workers, int count, const F &fn) {
+    if (!pool || workers <= 1) {
+        for (int i = 0; i < count; ++i) fn(i);
+        return;
+    }
+    std::atomic<int> next(0);
+    TaskPool::Group g;
+    for (int w = 0; w < workers; ++w) {
+        pool->spawn(g, [&] {
+            int i;
+            while ((i = next.fetch_add(1)) < count) fn(i);
+        });
+    }
+    pool->wait(g);
+}
+
+// One distribution step of in-place super scalar samplesort (IPS4o) over
+// a[0, n):
+//
+// 1. Local classification. Every stripe streams its elements into one
+//    block-sized buffer per bucket. A full buffer is flushed to the front
+//    of the stripe, over elements already read, so each stripe ends as
+//    whole single-bucket blocks followed by free space.
+// 2. Block permutation. Bucket boundaries are rounded up to blocks. Within
+//    each bucket's block range, the whole blocks are first moved to the
+//    front. Workers then pop unprocessed blocks and swap them into their
+//    buckets. Each bucket has one atomic word packing its write and read
+//    pointers, and a reader count so nobody overwrites a block that is
+//    still being copied out.
+// 3. Cleanup. The last block of a bucket may overhang into the next bucket.
+//    These overhangs are saved first. Then every bucket's unfilled head and
+//    tail receive its overhang, the partial buffers and, for the one block
+//    that would cross the end of the array, the overflow buffer.
+template <class T>
+class SamplesortStep {
+public:
+    SamplesortStep(T *a, int n, const BucketClassifier<T> &classifier, int stripes)
+        : a_(a), n_(n), cls_(classifier), K_(classifier.buckets()),
+          B_(std::max<int>(1, SAMPLESORT_BLOCK_BYTES / static_cast<int>(sizeof(T)))),
+          slots_((n + B_ - 1) / B_), stripes_(stripes),
+          stripeSlots_((slots_ + stripes - 1) / stripes),
+          buffers_(new T[static_cast<std::size_t>(stripes) * K_ * B_]),
+          swapBuffers_(new T[static_cast<std::size_t>(stripes) * 2 * B_]),
+          overflow_(new T[B_]), overhang_(new T[static_cast<std::size_t>(K_) * B_]),
+          partial_(static_cast<std::size_t>(stripes) * K_, 0),
+          full_(static_cast<std::size_t>(stripes) * K_, 0), writeEnd_(stripes, 0),
+          bucketStart_(K_ + 1, 0), firstSlot_(K_ + 1, 0), fullEnd_(K_, 0),
+          overhangCount_(K_, 0), pointers_(new std::atomic<std::uint64_t>[K_]),
+          reading_(new std::atomic<int>[K_]), overflowBucket_(-1) {}
+
+    // Distributes a[0, n); afterwards bucket j is a[start(j), start(j + 1)).
+    void run(TaskPool *pool) {
+        samplesort_for_each(pool, stripes_, stripes_, [this](int t) { classify_stripe(t); });
+        compute_boundaries();
+        samplesort_for_each(pool, stripes_, K_, [this](int j) { gather_full_blocks(j); });
+        samplesort_for_each(pool, stripes_, stripes_, [this](int t) { permute(t); });
+        compute_full_ends();
+        samplesort_for_each(pool, stripes_, K_, [this](int j) { save_overhang(j); });
+        samplesort_for_each(pool, stripes_, K_, [this](int j) { fill_bucket(j); });
+    }
+
+    int start(int bucket) const { return bucketStart_[bucket]; }
+
+private:
+    static const std::uint64_t READ_BIAS = 1u << 20;
+
+    int stripe_begin(int t) const {
+        return static_cast<int>(std::min<long long>(n_, static_cast<long long>(t) * stripeSlots_ * B_));
+    }
+
+    bool slot_full(int s) const {
+        return static_cast<long long>(s) * B_ < writeEnd_[s / stripeSlots_];
+    }
+
+    void classify_stripe(int t) {
+        int lo = stripe_begin(t);
+        int hi = stripe_begin(t + 1);
+        T *buf = buffers_.get() + static_cast<std::size_t>(t) * K_ * B_;
+        int *fill = partial_.data() + static_cast<std::size_t>(t) * K_;
+        int *full = full_.data() + static_cast<std::size_t>(t) * K_;
+        int w = lo;
+        auto put = [&](int j, const T &x) {
+            T *b = buf + static_cast<std::size_t>(j) * B_;
+            b[fill[j]] = x;
+            if (++fill[j] == B_) {
+                std::copy(b, b + B_, a_ + w);
+                w += B_;
+                fill[j] = 0;
+                ++full[j];
+            }
+        };
+        int i = lo;
+        int bucket[SAMPLESORT_BATCH];
+        for (; i + SAMPLESORT_BATCH <= hi; i += SAMPLESORT_BATCH) {
+            cls_.classify_batch(a_ + i, bucket);
+            for (int e = 0; e < SAMPLESORT_BATCH; ++e) put(bucket[e], a_[i + e]);
+        }
+        for (; i < hi; ++i) put(cls_.classify(a_[i]), a_[i]);
+        writeEnd_[t] = w;
+    }
+
+    void compute_boundaries() {
+        for (int j = 0; j < K_; ++j) {
+            long long size = 0;
+            for (int t = 0; t < stripes_; ++t) {
+                std::size_t idx = static_cast<std::size_t>(t) * K_ + j;
+                size += static_cast<long long>(full_[idx]) * B_ + partial_[idx];
+            }
+            bucketStart_[j + 1] = bucketStart_[j] + static_cast<int>(size);
+        }
+        for (int j = 0; j <= K_; ++j) firstSlot_[j] = (bucketStart_[j] + B_ - 1) / B_;
+    }
+
+    // Moves the whole blocks inside bucket j's slot range to its front and
+    // sets up the bucket's write/read pointer pair over them.
+    void gather_full_blocks(int j) {
+        int lo = firstSlot_[j];
+        int hi = std::min(firstSlot_[j + 1], slots_);
+        int i = lo;
+        int k = hi - 1;
+        while (true) {
+            while (i <= k && slot_full(i)) ++i;
+            while (k > i && !slot_full(k)) --k;
+            if (i >= k) break;
+            std::copy(a_ + static_cast<std::size_t>(k) * B_, a_ + static_cast<std::size_t>(k + 1) * B_,
+                      a_ + static_cast<std::size_t>(i) * B_);
+            ++i;
+            --k;
+        }
+        pointers_[j].store(READ_BIAS + std::max(0, i - lo));
+        reading_[j].store(0);
+    }
+
+    // Takes the last unprocessed block of bucket j into dst.
+    bool pop_block(int j, T *dst) {
+        reading_[j].fetch_add(1);
+        std::uint64_t old = pointers_[j].fetch_sub(1);
+        long long write = static_cast<long long>(old >> 32);
+        long long readEnd = static_cast<long long>(old & 0xffffffffu) - static_cast<long long>(READ_BIAS);
+        bool ok = readEnd - 1 >= write;
+        if (ok) {
+            const T *src = a_ + static_cast<std::size_t>(firstSlot_[j] + readEnd - 1) * B_;
+            std::copy(src, src + B_, dst);
+        }
+        reading_[j].fetch_sub(1);
+        return ok;
+    }
+
+    // Claims bucket j's next destination slot; true when it still holds an
+    // unprocessed block, which now belongs to the caller.
+    bool claim_slot(int j, int &slot) {
+        std::uint64_t old = pointers_[j].fetch_add(std::uint64_t(1) << 32);
+        long long write = static_cast<long long>(old >> 32);
+        long long readEnd = static_cast<long long>(old & 0xffffffffu) - static_cast<long long>(READ_BIAS);
+        slot = firstSlot_[j] + static_cast<int>(write);
+        return write < readEnd;
+    }
+
+    void permute(int t) {
+        T *swap[2] = {swapBuffers_.get() + static_cast<std::size_t>(t) * 2 * B_,
+                      swapBuffers_.get() + static_cast<std::size_t>(t) * 2 * B_ + B_};
+        int first = static_cast<int>(static_cast<long long>(t) * K_ / stripes_);
+        for (int step = 0; step < K_; ++step) {
+            int j = (first + step) % K_;
+            while (pop_block(j, swap[0])) {
+                int dest = cls_.classify(swap[0][0]);
+                while (true) {
+                    int slot;
+                    bool occupied = claim_slot(dest, slot);
+                    T *target = a_ + static_cast<std::size_t>(slot) * B_;
+                    if (occupied) {
+                        int there = cls_.classify(*target);
+                        if (there == dest) continue;
+                        std::copy(target, target + B_, swap[1]);
+                        std::copy(swap[0], swap[0] + B_, target);
+                        std::swap(swap[0], swap[1]);
+                        dest = there;
+                        continue;
+                    }
+                    while (reading_[dest].load() > 0) {
+                    }
+                    if (static_cast<long long>(slot + 1) * B_ > n_) {
+                        std::copy(swap[0], swap[0] + B_, overflow_.get());
+                        overflowBucket_ = dest;
+                    } else {
+                        std::copy(swap[0], swap[0] + B_, target);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    void compute_full_ends() {
+        for (int j = 0; j < K_; ++j) {
+            long long blocks = 0;
+            for (int t = 0; t < stripes_; ++t) blocks += full_[static_cast<std::size_t>(t) * K_ + j];
+            if (j == overflowBucket_) --blocks;
+            fullEnd_[j] = static_cast<int>((firstSlot_[j] + blocks) * B_);
+        }
+    }
+
+    void save_overhang(int j) {
+        int end = bucketStart_[j + 1];
+        int count = std::max(0, fullEnd_[j] - std::max(end, firstSlot_[j] * B_));
+        std::copy(a_ + end, a_ + end + count, overhang_.get() + static_cast<std::size_t>(j) * B_);
+        overhangCount_[j] = count;
+    }
+
+    // Writes bucket j's loose elements into the parts of its range that no
+    // whole block covers.
+    void fill_bucket(int j) {
+        int begin = bucketStart_[j];
+        int end = bucketStart_[j + 1];
+        int blocksBegin = firstSlot_[j] * B_;
+        int pos = begin;
+        int gapEnd = end;
+        int resume = end;
+        if (fullEnd_[j] > blocksBegin) {
+            gapEnd = blocksBegin;
+            resume = std::min(fullEnd_[j], end);
+        }
+        auto emit = [&](const T *src, int count) {
+            for (int i = 0; i < count; ++i) {
+                if (pos == gapEnd) pos = resume;
+                a_[pos++] = src[i];
+            }
+        };
+        emit(overhang_.get() + static_cast<std::size_t>(j) * B_, overhangCount_[j]);
+        for (int t = 0; t < stripes_; ++t) {
+            std::size_t idx = static_cast<std::size_t>(t) * K_ + j;
+            emit(buffers_.get() + idx * B_, partial_[idx]);
+        }
+        if (j == overflowBucket_) emit(overflow_.get(), B_);
+    }
+
+    T *a_;
+    int n_;
+    const BucketClassifier<T> &cls_;
+    int K_;
+    int B_;
+    int slots_;
+    int stripes_;
+    int stripeSlots_;
+    std::unique_ptr<T[]> buffers_;
+    std::unique_ptr<T[]> swapBuffers_;
+    std::unique_ptr<T[]> overflow_;
+    std::unique_ptr<T[]> overhang_;
+    std::vector<int> partial_;
+    std::vector<int> full_;
+    std::vector<int> writeEnd_;
+    std::vector<int> bucketStart_;
+    std::vector<int> firstSlot_;
+    std::vector<int> fullEnd_;
+    std::vector<int> overhangCount_;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> pointers_;
+    std::unique_ptr<std::atomic<int>[]> reading_;
+    int overflowBucket_;
+};
+
+// Sorted, de-duplicated splitters from an evenly oversampled random sample;
+// logBuckets is lowered when duplicates leave fewer splitters.
+template <class T>
+std::vector<T> choose_splitters(const T *a, int n, int &logBuckets) {
+    int k = 1 << logBuckets;
+    int log2n = 0;
+    for (int m = n; m > 1; m >>= 1) ++log2n;
+    int oversample = std::max(1, log2n / 5);
+    std::vector<T> sample(static_cast<std::size_t>(k) * oversample);
+    std::uint64_t state = 0x9e3779b97f4a7c15ull ^ static_cast<std::uint64_t>(n);
+    for (T &x : sample) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        x = a[state % static_cast<std::uint64_t>(n)];
+    }
+    std::sort(sample.begin(), sample.end());
+
+    std::vector<T> splitters;
+    for (int i = 1; i < k; ++i) splitters.push_back(sample[static_cast<std::size_t>(i) * oversample - 1]);
+    splitters.erase(std::unique(splitters.begin(), splitters.end()), splitters.end());
+    while (logBuckets > 1 && (1 << (logBuckets - 1)) - 1 >= static_cast<int>(splitters.size())) --logBuckets;
+    return splitters;
+}
+
+// Sorts a[begin, end). pool is null inside serial tasks. Buckets that are
+// not equality buckets recurse; serial(begin, end, depthLimit) sorts ranges
+// up to SAMPLESORT_BASE.
+template <class T, class SerialSort>
+void samplesort_rec(TaskPool *pool, T *a, int begin, int end, int levels, const SerialSort &serial) {
+    int n = end - begin;
+    if (n <= SAMPLESORT_BASE || levels == 0) {
+        int depthLimit = 0;
+        for (int m = n; m > 1; m >>= 1) ++depthLimit;
+        serial(begin, end, 2 * depthLimit);
+        return;
+    }
+
+    // Buckets are capped so the per-stripe buffers stay below a quarter of
+    // the range.
+    int blockElems = std::max<int>(1, SAMPLESORT_BLOCK_BYTES / static_cast<int>(sizeof(T)));
+    int logBuckets = 1;
+    while (logBuckets < SAMPLESORT_MAX_LOG_BUCKETS &&
+           (4LL << (logBuckets + 2)) * blockElems <= n) {
+        ++logBuckets;
+    }
+    std::vector<T> splitters = choose_splitters(a + begin, n, logBuckets);
+    BucketClassifier<T> classifier(splitters, logBuckets);
+
+    bool parallel = pool && pool->size() > 1 && n >= SAMPLESORT_PARALLEL_MIN;
+    std::vector<int> bounds(classifier.buckets() + 1);
+    {
+        SamplesortStep<T> step(a + begin, n, classifier, parallel ? pool->size() : 1);
+        step.run(parallel ? pool : nullptr);
+        for (int j = 0; j <= classifier.buckets(); ++j) bounds[j] = begin + step.start(j);
+    }
+
+    TaskPool::Group g;
+    for (int j = 0; j < classifier.buckets(); ++j) {
+        int lo = bounds[j];
+        int hi = bounds[j + 1];
+        if (hi - lo <= 1 || classifier.is_equality(j)) continue;
+        if (!pool) {
+            samplesort_rec(pool, a, lo, hi, levels - 1, serial);
+        } else {
+            TaskPool *child = hi - lo >= SAMPLESORT_PARALLEL_MIN ? pool : nullptr;
+            pool->spawn(g, [=, &serial] { samplesort_rec(child, a, lo, hi, levels - 1, serial); });
+        }
+    }
+    if (pool) pool->wait(g);
+}
+
+template <class T, class SerialSort>
+void samplesort(TaskPool &pool, std::vector<T> &a, const SerialSort &serial) {
+    int n = static_cast<int>(a.size());
+    if (n <= 1) return;
+    pool.run([&] { samplesort_rec(&pool, a.data(), 0, n, SAMPLESORT_MAX_LEVELS, serial); });
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+
+#include <sched.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+// Hardware counters read around each timed run: cycles, instructions,
+// branch misses and last-level cache misses, opened as one perf_event group
+// so they cover the same interval. Events the kernel or the (virtual) CPU
+// does not expose are skipped and report -1; with none available the
+// harness times runs alone.
+class PerfCounters {
+public:
+    static const int COUNT = 4;
+
+    PerfCounters() : leader_(-1), opened_(0) {
+        static const std::uint64_t events[COUNT] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+        for (int i = 0; i < COUNT; ++i) {
+            slot_[i] = -1;
+            fds_[i] = -1;
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = events[i];
+            attr.disabled = leader_ < 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            long fd = syscall(__NR_perf_event_open, &attr, 0, -1, leader_, 0);
+            if (fd < 0) continue;
+            fds_[i] = static_cast<int>(fd);
+            if (leader_ < 0) leader_ = fds_[i];
+            slot_[i] = opened_++;
+        }
+    }
+
+    ~PerfCounters() {
+        for (int fd : fds_) {
+            if (fd >= 0) close(fd);
+        }
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    bool available() const { return leader_ >= 0; }
+
+    void start() {
+        if (leader_ < 0) return;
+        ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    // values[i] is the count of event i since start(), or -1.
+    void stop(long long values[COUNT]) {
+        for (int i = 0; i < COUNT; ++i) values[i] = -1;
+        if (leader_ < 0) return;
+        ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        std::uint64_t buf[1 + COUNT];
+        if (read(leader_, buf, sizeof(buf)) < static_cast<ssize_t>(sizeof(std::uint64_t))) return;
+        for (int i = 0; i < COUNT; ++i) {
+            if (slot_[i] >= 0 && slot_[i] < static_cast<int>(buf[0])) {
+                values[i] = static_cast<long long>(buf[1 + slot_[i]]);
+            }
+        }
+    }
+
+private:
+    int leader_;
+    int opened_;
+    int fds_[COUNT];
+    int slot_[COUNT];
+};
+
+// Binds the calling thread to one CPU so migrations do not show up as noise;
+// false when the CPU does not exist or affinity cannot be set.
+inline bool pin_to_cpu(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+// Untimed warmups first, then at least minRepeats timed runs, continuing
+// until their total reaches minTotalNs or maxRepeats is hit. Small inputs
+// therefore get many repetitions and large ones few.
+struct BenchOptions {
+    int warmups = 1;
+    int minRepeats = 5;
+    int maxRepeats = 200;
+    long long minTotalNs = 2000000;
+};
+
+// Per-run nanoseconds summarised by order statistics; counters are medians
+// over the same runs (-1 when unavailable).
+struct BenchResult {
+    int repeats = 0;
+    long long minNs = 0;
+    long long p10Ns = 0;
+    long long medianNs = 0;
+    long long p90Ns = 0;
+    long long maxNs = 0;
+    long long meanNs = 0;
+    long long counters[PerfCounters::COUNT] = {-1, -1, -1, -1};
+};
+
+// Nearest-rank percentile of sorted values, p in [0, 100].
+inline long long percentile(const std::vector<long long> &sorted, int p) {
+    if (sorted.empty()) return 0;
+    std::size_t rank = (sorted.size() * static_cast<std::size_t>(p) + 99) / 100;
+    return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+// One algorithm under test. load() takes the generated input outside the
+// timed region, reset() restores the working copy before every run, run()
+// is the timed sort and sorted() checks the last result.
+struct BenchCase {
+    std::string algorithm;
+    int param = 0;
+    std::function<void(const std::vector<int> &)> load;
+    std::function<void()> reset;
+    std::function<void()> run;
+    std::function<bool()> sorted;
+};
+
+template <class T>
+struct SortCaseState {
+    std::vector<T> base;
+    std::vector<T> a;
+    std::vector<T> tmp;
+};
+
+// Case for sort(std::vector<T> &a, std::vector<T> &tmp) on the generated
+// ints widened to T; tmp is sized to the input and may be ignored.
+template <class T, class Sort>
+BenchCase sort_case(const std::string &algorithm, int param, Sort sort) {
+    auto state = std::make_shared<SortCaseState<T>>();
+    BenchCase c;
+    c.algorithm = algorithm;
+    c.param = param;
+    c.load = [state](const std::vector<int> &input) {
+        state->base.assign(input.begin(), input.end());
+        state->a.resize(input.size());
+        state->tmp.resize(input.size());
+    };
+    c.reset = [state]() { std::copy(state->base.begin(), state->base.end(), state->a.begin()); };
+    c.run = [state, sort]() mutable { sort(state->a, state->tmp); };
+    c.sorted = [state]() { return std::is_sorted(state->a.begin(), state->a.end()); };
+    return c;
+}
+
+inline BenchResult run_benchmark(BenchCase &c, const BenchOptions &opt, PerfCounters *counters) {
+    for (int w = 0; w < opt.warmups; ++w) {
+        c.reset();
+        c.run();
+    }
+
+    std::vector<long long> ns;
+    std::vector<long long> counts[PerfCounters::COUNT];
+    long long total = 0;
+    while (static_cast<int>(ns.size()) < opt.minRepeats ||
+           (total < opt.minTotalNs && static_cast<int>(ns.size()) < opt.maxRepeats)) {
+        c.reset();
+        if (counters) counters->start();
+        auto start = std::chrono::steady_clock::now();
+        c.run();
+        auto end = std::chrono::steady_clock::now();
+        long long values[PerfCounters::COUNT] = {-1, -1, -1, -1};
+        if (counters) counters->stop(values);
+        long long t = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        ns.push_back(t);
+        total += t;
+        for (int i = 0; i < PerfCounters::COUNT; ++i) {
+            if (values[i] >= 0) counts[i].push_back(values[i]);
+        }
+    }
+
+    BenchResult r;
+    r.repeats = static_cast<int>(ns.size());
+    r.meanNs = total / r.repeats;
+    std::sort(ns.begin(), ns.end());
+    r.minNs = ns.front();
+    r.p10Ns = percentile(ns, 10);
+    r.medianNs = percentile(ns, 50);
+    r.p90Ns = percentile(ns, 90);
+    r.maxNs = ns.back();
+    for (int i = 0; i < PerfCounters::COUNT; ++i) {
+        if (counts[i].empty()) continue;
+        std::sort(counts[i].begin(), counts[i].end());
+        r.counters[i] = percentile(counts[i], 50);
+    }
+    return r;
+}
+
+// Result rows as CSV, or as a JSON array of objects when json is set. The
+// columns are the same in both formats.
+class BenchWriter {
+public:
+    BenchWriter(const std::string &path, bool json) : out_(path), json_(json), rows_(0) {
+        if (!out_) return;
+        if (json_) out_ << "[\n";
+        else out_ << "n,array_type,algorithm,param,repeats,min_ns,p10_ns,median_ns,p90_ns,"
+                     "max_ns,mean_ns,cycles,instructions,branch_misses,llc_misses\n";
+    }
+
+    ~BenchWriter() {
+        if (out_ && json_) out_ << (rows_ ? "\n]\n" : "]\n");
+    }
+
+    bool ok() const { return static_cast<bool>(out_); }
+
+    void row(int n, const char *arrayType, const BenchCase &c, const BenchResult &r) {
+        const long long *k = r.counters;
+        if (json_) {
+            out_ << (rows_ ? ",\n" : "") << "  {\"n\": " << n << ", \"array_type\": \""
+                 << arrayType << "\", \"algorithm\": \"" << c.algorithm << "\", \"param\": "
+                 << c.param << ", \"repeats\": " << r.repeats << ", \"min_ns\": " << r.minNs
+                 << ", \"p10_ns\": " << r.p10Ns << ", \"median_ns\": " << r.medianNs
+                 << ", \"p90_ns\": " << r.p90Ns << ", \"max_ns\": " << r.maxNs
+                 << ", \"mean_ns\": " << r.meanNs << ", \"cycles\": " << k[0]
+                 << ", \"instructions\": " << k[1] << ", \"branch_misses\": " << k[2]
+                 << ", \"llc_misses\": " << k[3] << '}';
+        } else {
+            out_ << n << ',' << arrayType << ',' << c.algorithm << ',' << c.param << ','
+                 << r.repeats << ',' << r.minNs << ',' << r.p10Ns << ',' << r.medianNs << ','
+                 << r.p90Ns << ',' << r.maxNs << ',' << r.meanNs << ',' << k[0] << ','
+                 << k[1] << ',' << k[2] << ',' << k[3] << '\n';
+        }
+        ++rows_;
+    }
+
+private:
+    std::ofstream out_;
+    bool json_;
+    long long rows_;
+};
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+// Persisted small-input cutoffs, one "key value" line each; '#' starts a
+// comment. Keys are "<algorithm>.<type>.<shape>", e.g. merge.int64.random.
+// Several programs share one file and only touch their own keys.
+class CutoffProfile {
+public:
+    bool load(const std::string &path) {
+        std::ifstream in(path);
+        if (!in) return false;
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream ls(line);
+            std::string key;
+            int value;
+            if (!(ls >> key) || key[0] == '#' || !(ls >> value) || value < 1) continue;
+            values_[key] = value;
+        }
+        return true;
+    }
+
+    bool save(const std::string &path) const {
+        std::ofstream out(path);
+        if (!out) return false;
+        out << "# insertion-sort cutoffs measured on this machine\n";
+        for (const auto &kv : values_) out << kv.first << ' ' << kv.second << '\n';
+        return static_cast<bool>(out);
+    }
+
+    bool empty() const { return values_.empty(); }
+
+    int get(const std::string &key, int fallback) const {
+        auto it = values_.find(key);
+        return it == values_.end() ? fallback : it->second;
+    }
+
+    void set(const std::string &key, int value) { values_[key] = value; }
+
+private:
+    std::map<std::string, int> values_;
+};
+
+// $SORT_PROFILE, or sort_profile.txt in the working directory.
+inline std::string default_profile_path() {
+    const char *env = std::getenv("SORT_PROFILE");
+    return env && *env ? env : "sort_profile.txt";
+}
+
+enum class InputShape { Random, Reversed, Almost };
+
+inline const char *shape_name(InputShape s) {
+    if (s == InputShape::Reversed) return "reversed";
+    if (s == InputShape::Almost) return "almost";
+    return "random";
+}
+
+template <class T> inline const char *type_name();
+template <> inline const char *type_name<int>() { return "int32"; }
+template <> inline const char *type_name<long long>() { return "int64"; }
+
+inline std::string cutoff_key(const char *algorithm, const char *type, InputShape s) {
+    return std::string(algorithm) + "." + type + "." + shape_name(s);
+}
+
+// One pass over the input: mostly ascending neighbours means almost sorted,
+// mostly descending means reversed, anything else is treated as random.
+template <class T>
+InputShape classify_shape(const T *a, int n) {
+    if (n < 2) return InputShape::Random;
+    long long up = 0;
+    long long down = 0;
+    for (int i = 1; i < n; ++i) {
+        up += a[i - 1] < a[i];
+        down += a[i] < a[i - 1];
+    }
+    long long pairs = n - 1;
+    if (down * 10 <= pairs) return InputShape::Almost;
+    if (up * 10 <= pairs) return InputShape::Reversed;
+    return InputShape::Random;
+}
+
+// Same shapes as the experiment generators: uniform values, the sorted
+// values reversed, or sorted with n / 20 random swaps.
+template <class T>
+void make_shape_input(std::vector<T> &a, int n, InputShape s, std::uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    a.resize(n);
+    for (auto &x : a) x = static_cast<T>(rng());
+    if (s == InputShape::Random) return;
+    std::sort(a.begin(), a.end());
+    if (s == InputShape::Reversed) {
+        std::reverse(a.begin(), a.end());
+        return;
+    }
+    for (int k = 0; k < n / 20; ++k) std::swap(a[rng() % n], a[rng() % n]);
+}
+
+// Not a power of two: with midpoint splits every cutoff in [2^k, 2^(k+1))
+// would otherwise produce identical leaves and time the same.
+static const int CALIBRATION_N = 100000;
+static const int CALIBRATION_REPEATS = 7;
+
+// Median time in ns of sort(a, cutoff) over CALIBRATION_REPEATS copies of base.
+template <class T, class Sort>
+long long time_cutoff(Sort &sort, const std::vector<T> &base, int cutoff) {
+    std::vector<long long> ns;
+    std::vector<T> a;
+    for (int rep = 0; rep < CALIBRATION_REPEATS; ++rep) {
+        a = base;
+        auto start = std::chrono::steady_clock::now();
+        sort(a, cutoff);
+        auto end = std::chrono::steady_clock::now();
+        ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+    std::nth_element(ns.begin(), ns.begin() + ns.size() / 2, ns.end());
+    return ns[ns.size() / 2];
+}
+
+// Coarse geometric grid of cutoffs, then the midpoints on both sides of the
+// best one. sort(std::vector<T> &, int cutoff) must sort the whole vector.
+template <class T, class Sort>
+int tune_cutoff(Sort sort, InputShape shape) {
+    static const int grid[] = {4, 6, 8, 12, 16, 24, 32, 48, 64, 96, 128};
+    const int gridSize = sizeof(grid) / sizeof(grid[0]);
+    std::vector<T> base;
+    make_shape_input(base, CALIBRATION_N, shape, 20240611u + static_cast<unsigned>(shape));
+
+    int bestIdx = 0;
+    long long bestNs = -1;
+    for (int i = 0; i < gridSize; ++i) {
+        long long ns = time_cutoff(sort, base, grid[i]);
+        if (bestNs < 0 || ns < bestNs) {
+            bestNs = ns;
+            bestIdx = i;
+        }
+    }
+    int best = grid[bestIdx];
+    int probes[2] = {bestIdx > 0 ? (grid[bestIdx - 1] + best) / 2 : best,
+                     bestIdx + 1 < gridSize ? (grid[bestIdx + 1] + best) / 2 : best};
+    for (int c : probes) {
+        if (c == best) continue;
+        long long ns = time_cutoff(sort, base, c);
+        if (ns < bestNs) {
+            bestNs = ns;
+            best = c;
+        }
+    }
+    return best;
+}
+
+// Tunes algorithm's cutoff for T on every input shape and stores the results.
+template <class T, class Sort>
+void calibrate_cutoffs(CutoffProfile &profile, const char *algorithm, Sort sort) {
+    const InputShape shapes[3] = {InputShape::Random, InputShape::Reversed, InputShape::Almost};
+    for (InputShape s : shapes) {
+        profile.set(cutoff_key(algorithm, type_name<T>(), s), tune_cutoff<T>(sort, s));
+    }
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <vector>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const std::size_t FAST_IO_BLOCK = 1 << 20;
+
+// A block refill keeps at least this much contiguous input ahead of the
+// parser: a sign, 19 digits and slack. Longer tokens, such as numbers with
+// many leading zeros, continue across refills.
+static const std::size_t FAST_IO_TOKEN = 64;
+
+// Whitespace-separated signed integers from a descriptor. A regular file is
+// mapped and parsed in place; a pipe or terminal is read in FAST_IO_BLOCK
+// pieces, so memory stays bounded for streaming consumers. Digits are taken
+// eight at a time with SWAR arithmetic when possible. Parsing follows
+// operator>>: optional sign, then decimal digits; next() fails on anything
+// else and stays failed, leaving x untouched. A value out of range for x
+// consumes the whole token, saturates x to the nearest limit and fails.
+class FastInput {
+public:
+    explicit FastInput(int fd = 0)
+        : fd_(fd), p_(nullptr), end_(nullptr), map_(nullptr), mapLen_(0),
+          eof_(false), failed_(false) {
+        struct stat st;
+        off_t pos = lseek(fd_, 0, SEEK_CUR);
+        if (pos >= 0 && fstat(fd_, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > pos) {
+            void *m = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ,
+                           MAP_PRIVATE, fd_, 0);
+            if (m != MAP_FAILED) {
+                map_ = static_cast<const char *>(m);
+                mapLen_ = static_cast<std::size_t>(st.st_size);
+                madvise(m, mapLen_, MADV_SEQUENTIAL);
+                p_ = map_ + pos;
+                end_ = map_ + mapLen_;
+                eof_ = true;
+                return;
+            }
+        }
+        buf_.resize(FAST_IO_BLOCK + FAST_IO_TOKEN);
+        p_ = end_ = buf_.data();
+    }
+
+    ~FastInput() {
+        if (map_) munmap(const_cast<char *>(map_), mapLen_);
+    }
+
+    FastInput(const FastInput &) = delete;
+    FastInput &operator=(const FastInput &) = delete;
+
+    bool next(long long &x) { return parse(x); }
+    bool next(int &x) { return parse(x); }
+
+private:
+    // Digits are accumulated unsigned; |min| of Int is one more than max.
+    template <class Int>
+    bool parse(Int &x) {
+        if (failed_) return false;
+        while (true) {
+            while (p_ < end_ && is_space(*p_)) ++p_;
+            if (p_ < end_ || !refill()) break;
+        }
+        if (static_cast<std::size_t>(end_ - p_) < FAST_IO_TOKEN) refill();
+
+        const char *s = p_;
+        bool neg = false;
+        if (s < end_ && (*s == '-' || *s == '+')) {
+            neg = *s == '-';
+            ++s;
+        }
+        if (s == end_ || static_cast<unsigned>(*s - '0') > 9) {
+            failed_ = true;
+            return false;
+        }
+        unsigned long long v = 0;
+        bool overflow = false;
+        while (true) {
+            while (end_ - s >= 8) {
+                std::uint64_t chunk;
+                std::memcpy(&chunk, s, 8);
+                if (!eight_digits(chunk)) break;
+                accumulate(v, 100000000ull, parse_eight(chunk), overflow);
+                s += 8;
+            }
+            while (s < end_) {
+                unsigned d = static_cast<unsigned>(*s - '0');
+                if (d > 9) break;
+                accumulate(v, 10, d, overflow);
+                ++s;
+            }
+            // Digits up to the end of the buffer: the token may go on past it.
+            if (s < end_) break;
+            p_ = s;
+            if (!refill()) break;
+            s = p_;
+        }
+        p_ = s;
+        if (overflow || v > static_cast<unsigned long long>(std::numeric_limits<Int>::max()) + neg) {
+            x = neg ? std::numeric_limits<Int>::min() : std::numeric_limits<Int>::max();
+            failed_ = true;
+            return false;
+        }
+        x = neg ? static_cast<Int>(0ull - v) : static_cast<Int>(v);
+        return true;
+    }
+
+    // SWAR digit handling on 8 bytes loaded little-endian: every byte is in
+    // '0'..'9' iff its high nibble is 3 and adding 6 does not carry into it.
+    static bool eight_digits(std::uint64_t c) {
+        return ((c & 0xF0F0F0F0F0F0F0F0ull) |
+                (((c + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) ==
+               0x3333333333333333ull;
+    }
+
+    // Pairs, then quads, then the 8-digit value, with three multiplies.
+    static std::uint64_t parse_eight(std::uint64_t c) {
+        c -= 0x3030303030303030ull;
+        c = (c * 10) + (c >> 8);
+        c = (((c & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+             (((c >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+        return c;
+    }
+
+    // v = v * m + d; sets overflow if that wraps. The caller compares the
+    // result with the target type's range once the token ends.
+    static void accumulate(unsigned long long &v, unsigned long long m, unsigned long long d,
+                           bool &overflow) {
+        overflow |= __builtin_mul_overflow(v, m, &v) | __builtin_add_overflow(v, d, &v);
+    }
+
+    static bool is_space(char c) {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+    }
+
+    // Moves the unread tail to the front and reads more after it; false once
+    // nothing more can be read.
+    bool refill() {
+        if (eof_) return false;
+        std::size_t keep = static_cast<std::size_t>(end_ - p_);
+        std::memmove(buf_.data(), p_, keep);
+        p_ = buf_.data();
+        end_ = p_ + keep;
+        bool grew = false;
+        while (!eof_ && static_cast<std::size_t>(end_ - p_) < FAST_IO_TOKEN) {
+            ssize_t r = read(fd_, const_cast<char *>(end_), buf_.size() - keep);
+            if (r <= 0) {
+                eof_ = true;
+                break;
+            }
+            end_ += r;
+            keep += static_cast<std::size_t>(r);
+            grew = true;
+        }
+        return grew;
+    }
+
+    int fd_;
+    const char *p_;
+    const char *end_;
+    const char *map_;
+    std::size_t mapLen_;
+    bool eof_;
+    bool failed_;
+    std::vector<char> buf_;
+};
+
+// Buffered writer: numbers are formatted with std::to_chars straight into a
+// FAST_IO_BLOCK buffer that goes out with one write() per block.
+class FastOutput {
+public:
+    explicit FastOutput(int fd = 1) : fd_(fd), buf_(FAST_IO_BLOCK), pos_(0) {}
+    ~FastOutput() { flush(); }
+
+    FastOutput(const FastOutput &) = delete;
+    FastOutput &operator=(const FastOutput &) = delete;
+
+    void put(char c) {
+        if (pos_ == buf_.size()) flush();
+        buf_[pos_++] = c;
+    }
+
+    void put(long long x) {
+        if (buf_.size() - pos_ < FAST_IO_TOKEN) flush();
+        char *b = buf_.data() + pos_;
+        pos_ += static_cast<std::size_t>(std::to_chars(b, b + FAST_IO_TOKEN, x).ptr - b);
+    }
+
+    void flush() {
+        std::size_t done = 0;
+        while (done < pos_) {
+            ssize_t w = write(fd_, buf_.data() + done, pos_ - done);
+            if (w <= 0) break;
+            done += static_cast<std::size_t>(w);
+        }
+        pos_ = 0;
+    }
+
+private:
+    int fd_;
+    std::vector<char> buf_;
+    std::size_t pos_;
+};
+
+// Descriptor for --input: the named file, or stdin when path is null.
+inline int open_input(const char *path) {
+    return path ? open(path, O_RDONLY) : 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define X86_KERNELS 1
+#endif
+
+enum class KernelKind { Scalar, Avx2, Avx512 };
+
+inline const char *kernel_name(KernelKind k) {
+    if (k == KernelKind::Avx512) return "avx512";
+    if (k == KernelKind::Avx2) return "avx2";
+    return "scalar";
+}
+
+inline bool kernel_supported(KernelKind k) {
+#ifdef X86_KERNELS
+    if (k == KernelKind::Avx512) return __builtin_cpu_supports("avx512f");
+    if (k == KernelKind::Avx2) return __builtin_cpu_supports("avx2");
+    return true;
+#else
+    return k == KernelKind::Scalar;
+#endif
+}
+
+inline KernelKind detect_kernel() {
+    if (kernel_supported(KernelKind::Avx512)) return KernelKind::Avx512;
+    if (kernel_supported(KernelKind::Avx2)) return KernelKind::Avx2;
+    return KernelKind::Scalar;
+}
+
+inline bool parse_kernel(const char *s, KernelKind &k) {
+    if (std::strcmp(s, "scalar") == 0) k = KernelKind::Scalar;
+    else if (std::strcmp(s, "avx2") == 0) k = KernelKind::Avx2;
+    else if (std::strcmp(s, "avx512") == 0) k = KernelKind::Avx512;
+    else return false;
+    return kernel_supported(k);
+}
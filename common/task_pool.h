@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fork-join pool with one deque per worker. A worker pushes and pops its own
+// tasks at the back (depth-first, cache-warm) and steals from the front of the
+// other deques when it runs dry. wait() never blocks: the waiting thread keeps
+// executing tasks until its group is done, so nested spawn/wait cannot
+// deadlock. Helpers sleep between run() calls so an idle pool costs nothing.
+class TaskPool {
+public:
+    class Group {
+    public:
+        Group() : pending_(0) {}
+
+    private:
+        friend class TaskPool;
+        std::atomic<int> pending_;
+    };
+
+    explicit TaskPool(int threads)
+        : queues_(threads < 1 ? 1 : threads), stop_(false), active_(false) {
+        for (int i = 1; i < size(); ++i) {
+            helpers_.emplace_back([this, i] { helper_loop(i); });
+        }
+    }
+
+    ~TaskPool() {
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex_);
+            stop_ = true;
+        }
+        idle_cv_.notify_all();
+        for (auto &t : helpers_) t.join();
+    }
+
+    TaskPool(const TaskPool &) = delete;
+    TaskPool &operator=(const TaskPool &) = delete;
+
+    int size() const { return static_cast<int>(queues_.size()); }
+
+    // Runs f on the calling thread as worker 0 with the helpers awake.
+    template <class F>
+    void run(F &&f) {
+        int saved = worker_index();
+        TaskPool *savedPool = current_pool();
+        current_pool() = this;
+        worker_index() = 0;
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex_);
+            active_ = true;
+        }
+        idle_cv_.notify_all();
+        f();
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex_);
+            active_ = false;
+        }
+        current_pool() = savedPool;
+        worker_index() = saved;
+    }
+
+    void spawn(Group &g, std::function<void()> fn) {
+        g.pending_.fetch_add(1, std::memory_order_relaxed);
+        Queue &q = queues_[current_pool() == this ? worker_index() : 0];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.tasks.push_back(Task{std::move(fn), &g});
+    }
+
+    void wait(Group &g) {
+        int self = current_pool() == this ? worker_index() : 0;
+        while (g.pending_.load(std::memory_order_acquire) > 0) {
+            if (!run_one(self)) std::this_thread::yield();
+        }
+    }
+
+private:
+    struct Task {
+        std::function<void()> fn;
+        Group *group;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    static int &worker_index() {
+        static thread_local int index = 0;
+        return index;
+    }
+
+    static TaskPool *&current_pool() {
+        static thread_local TaskPool *pool = nullptr;
+        return pool;
+    }
+
+    bool pop_own(int self, Task &task) {
+        Queue &q = queues_[self];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) return false;
+        task = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(int self, Task &task) {
+        int n = size();
+        for (int k = 1; k < n; ++k) {
+            Queue &q = queues_[(self + k) % n];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) continue;
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    bool run_one(int self) {
+        Task task;
+        if (!pop_own(self, task) && !steal(self, task)) return false;
+        task.fn();
+        task.group->pending_.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    void helper_loop(int index) {
+        current_pool() = this;
+        worker_index() = index;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(idle_mutex_);
+                idle_cv_.wait(lock, [this] { return stop_ || active_; });
+                if (stop_) return;
+            }
+            while (active_.load(std::memory_order_relaxed)) {
+                if (!run_one(index)) std::this_thread::yield();
+            }
+        }
+    }
+
+    std::vector<Queue> queues_;
+    std::vector<std::thread> helpers_;
+    std::mutex idle_mutex_;
+    std::condition_variable idle_cv_;
+    bool stop_;
+    std::atomic<bool> active_;
+};